@@ -0,0 +1,277 @@
+// ========================================================================================================
+// Benchmark runner - runs every registered benchmark (optionally filtered) and prints the results.
+//
+//     ./main_bench [--benchmark_filter=<regex>] [--benchmark_min_time=<seconds>]
+//                  [--benchmark_format=console|json] [--benchmark_out=<file>]
+//
+// --benchmark_out always writes JSON, so a console run can be archived for regression tracking.
+// ========================================================================================================
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <thread>
+#include "Bench.h"
+
+using namespace std;
+
+namespace bench
+{
+
+// ====================== State ======================
+
+State::State(long max_iterations, const vector<long> &args)
+{
+    this->max_iterations = max_iterations;
+    this->args = args;
+    this->items_processed = 0;
+    this->real_seconds = 0;
+    this->cpu_seconds = 0;
+    this->running = false;
+}
+
+State::Iterator State::begin()
+{
+    this->StartTimer();
+    return Iterator{this, this->max_iterations};
+}
+
+State::Iterator State::end()
+{
+    return Iterator{this, 0};
+}
+
+void State::StartTimer()
+{
+    this->running = true;
+    this->real_start = chrono::steady_clock::now();
+    this->cpu_start = clock();
+}
+
+void State::StopTimer()
+{
+    if (!this->running)
+        return;
+
+    this->real_seconds += chrono::duration<double>(chrono::steady_clock::now() - this->real_start).count();
+    this->cpu_seconds += double(clock() - this->cpu_start) / CLOCKS_PER_SEC;
+    this->running = false;
+}
+
+void State::PauseTiming()
+{
+    this->StopTimer();
+}
+
+void State::ResumeTiming()
+{
+    this->StartTimer();
+}
+
+// ====================== Registry ======================
+
+static vector<Benchmark*> &Registry()
+{
+    static vector<Benchmark*> benchmarks;
+    return benchmarks;
+}
+
+Benchmark::Benchmark(const string &name, Function function)
+{
+    this->name = name;
+    this->function = function;
+}
+
+Benchmark *Benchmark::Arg(long arg)
+{
+    this->args.push_back(arg);
+    return this;
+}
+
+Benchmark *RegisterBenchmark(const string &name, Function function)
+{
+    Benchmark *b = new Benchmark(name, function);
+    Registry().push_back(b);
+    return b;
+}
+
+}
+
+// ====================== Runner ======================
+
+struct Result
+{
+    string name;
+    long iterations;
+    double real_ns, cpu_ns;
+    double items_per_second;
+};
+
+// Grow the iteration count until one run takes at least `min_time` seconds
+static Result Run(bench::Benchmark *b, const vector<long> &args, const string &name, double min_time)
+{
+    long n = 1;
+    while(true)
+    {
+        bench::State state(n, args);
+        b->function(state);
+
+        double t = state.real_seconds;
+        if (t >= min_time || n >= 1000000000L)
+        {
+            Result r;
+            r.name = name;
+            r.iterations = n;
+            r.real_ns = 1e9 * state.real_seconds / n;
+            r.cpu_ns = 1e9 * state.cpu_seconds / n;
+            r.items_per_second = state.items_processed > 0 ? state.items_processed / state.real_seconds : 0;
+            return r;
+        }
+
+        // Aim a bit past the target based on this run, but grow at most 10x at a time
+        double scale = t > 0 ? 1.4 * min_time / t : 10;
+        n = max(n + 1, (long)(n * min(10.0, scale)));
+    }
+}
+
+static string JsonEscape(const string &s)
+{
+    string out;
+    for(char c : s)
+    {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+static string ToJson(const vector<Result> &results)
+{
+    char date[64];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+    ostringstream json;
+    json.precision(17);
+    json << "{\n";
+    json << "  \"context\": {\n";
+    json << "    \"date\": \"" << date << "\",\n";
+    json << "    \"num_cpus\": " << thread::hardware_concurrency() << ",\n";
+#ifdef __OPTIMIZE__
+    json << "    \"library_build_type\": \"release\"\n";
+#else
+    json << "    \"library_build_type\": \"debug\"\n";
+#endif
+    json << "  },\n";
+    json << "  \"benchmarks\": [\n";
+    for(unsigned int i=0;i<results.size();i++)
+    {
+        const Result &r = results[i];
+        json << "    {\n";
+        json << "      \"name\": \"" << JsonEscape(r.name) << "\",\n";
+        json << "      \"run_type\": \"iteration\",\n";
+        json << "      \"iterations\": " << r.iterations << ",\n";
+        json << "      \"real_time\": " << r.real_ns << ",\n";
+        json << "      \"cpu_time\": " << r.cpu_ns << ",\n";
+        if (r.items_per_second > 0)
+            json << "      \"items_per_second\": " << r.items_per_second << ",\n";
+        json << "      \"time_unit\": \"ns\"\n";
+        json << "    }" << (i+1 < results.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n";
+    json << "}\n";
+
+    return json.str();
+}
+
+static bool Flag(const char *arg, const char *name, string &value)
+{
+    size_t n = strlen(name);
+    if (strncmp(arg, name, n) != 0 || arg[n] != '=')
+        return false;
+
+    value = string(arg + n + 1);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    string filter = ".", format = "console", out, value;
+    double min_time = 0.5;
+
+    for(int i=1;i<argc;i++)
+    {
+        if (Flag(argv[i], "--benchmark_filter", value))
+            filter = value;
+        else if (Flag(argv[i], "--benchmark_min_time", value))
+            min_time = atof(value.c_str());
+        else if (Flag(argv[i], "--benchmark_format", value))
+            format = value;
+        else if (Flag(argv[i], "--benchmark_out", value))
+            out = value;
+        else
+        {
+            cerr << "Error: Unknown argument " << argv[i] << endl;
+            return 1;
+        }
+    }
+
+    if (format != "console" && format != "json")
+    {
+        cerr << "Error: Unknown format " << format << " (valid choices: console, json)" << endl;
+        return 1;
+    }
+
+    regex re(filter);
+    bool console = (format == "console");
+    if (console)
+        printf("%-44s %15s %15s %12s %16s\n", "Benchmark", "Time (ns)", "CPU (ns)", "Iterations", "Items/s");
+
+    vector<Result> results;
+    for(bench::Benchmark *b : bench::Registry())
+    {
+        // A benchmark without arguments runs once with none
+        vector<vector<long> > runs;
+        if (b->args.empty())
+            runs.push_back(vector<long>());
+        for(long a : b->args)
+            runs.push_back(vector<long>(1, a));
+
+        for(const vector<long> &args : runs)
+        {
+            string name = b->name;
+            for(long a : args)
+                name += "/" + to_string(a);
+
+            if (!regex_search(name, re))
+                continue;
+
+            Result r = Run(b, args, name, min_time);
+            results.push_back(r);
+
+            if (console)
+            {
+                printf("%-44s %15.1f %15.1f %12ld", r.name.c_str(), r.real_ns, r.cpu_ns, r.iterations);
+                if (r.items_per_second > 0)
+                    printf(" %16.4g", r.items_per_second);
+                printf("\n");
+                fflush(stdout);
+            }
+        }
+    }
+
+    string json = ToJson(results);
+    if (!console)
+        cout << json;
+
+    if (!out.empty())
+    {
+        ofstream f(out);
+        f << json;
+    }
+
+    return 0;
+}
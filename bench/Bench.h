@@ -0,0 +1,107 @@
+#pragma once
+
+// ========================================================================================================
+// Minimal Google Benchmark style harness. Benchmarks are registered at static initialization time:
+//
+//     static void BM_Something(bench::State &state)
+//     {
+//         // setup (not timed)
+//         for(auto _ : state)
+//             bench::DoNotOptimize(Something(state.range(0)));
+//     }
+//     BENCHMARK(BM_Something)->Arg(4)->Arg(64);
+//
+// The runner (Bench.cpp) grows the iteration count until a run lasts at least --benchmark_min_time and
+// reports per-iteration times on the console or as JSON (same layout as Google Benchmark's JSON reporter).
+// ========================================================================================================
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ctime>
+
+namespace bench
+{
+
+class State
+{
+    public:
+    State(long max_iterations, const std::vector<long> &args);
+
+    // Range-for support: `for(auto _ : state)` runs the timed loop max_iterations times. The loop variable is a 
+    // Value, whose user-provided destructor keeps -Wunused-variable quiet about `_` (it compiles to nothing).
+    struct Value
+    {
+        ~Value() {}
+    };
+
+    struct Iterator
+    {
+        State *state;
+        long remaining;
+
+        bool operator!=(const Iterator &) const
+        {
+            if (remaining > 0)
+                return true;
+            state->StopTimer();
+            return false;
+        }
+        void operator++() { remaining--; }
+        Value operator*() const { return Value(); }
+    };
+    Iterator begin();
+    Iterator end();
+
+    long range(int i) const { return args[i]; }
+    long iterations() const { return max_iterations; }
+
+    // Exclude setup/teardown inside the loop from the measurement
+    void PauseTiming();
+    void ResumeTiming();
+
+    // Optional throughput: total items processed over all iterations
+    void SetItemsProcessed(double items) { items_processed = items; }
+
+    long max_iterations;
+    std::vector<long> args;
+    double items_processed;
+    double real_seconds, cpu_seconds;
+
+    private:
+    bool running;
+    std::chrono::steady_clock::time_point real_start;
+    std::clock_t cpu_start;
+
+    void StartTimer();
+    void StopTimer();
+};
+
+typedef void (*Function)(State &);
+
+class Benchmark
+{
+    public:
+    std::string name;
+    Function function;
+    std::vector<long> args;
+
+    Benchmark(const std::string &name, Function function);
+
+    // Register another run with argument `arg` (available as state.range(0))
+    Benchmark *Arg(long arg);
+};
+
+Benchmark *RegisterBenchmark(const std::string &name, Function function);
+
+// Keep the compiler from optimizing away a value or the computation producing it
+template <class T>
+inline void DoNotOptimize(T const &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}
+
+#define BENCHMARK_CONCAT2(a, b) a##b
+#define BENCHMARK_CONCAT(a, b) BENCHMARK_CONCAT2(a, b)
+#define BENCHMARK(f) static bench::Benchmark *BENCHMARK_CONCAT(benchmark_, __LINE__) = bench::RegisterBenchmark(#f, f)
@@ -0,0 +1,204 @@
+// ========================================================================================================
+// Driver benchmarks: MCDriver::MakeMove restricted to particle or cell moves, and the broad + narrow phase
+// for one particle (CollisionDetectedWith - which replaced the stored ghost images of UpdatePeriodicImages).
+// The argument is the number of particles. Items are MC moves / collision checks.
+// BM_MakeMove_Octahedron runs the same particle moves with the GJK narrow phase of ConvexPolyhedron, and
+// BM_MakeMove_Sphere runs them for dense hard spheres (argument: particles per cell edge). The BM_Decorrelation_*
+// pair compares Metropolis moves with event chains on those spheres (items: mean squared displacement), and
+// BM_MakeMoves_Checkerboard runs 4096 tetrahedra serially and in parallel checkerboard sweeps (argument: threads).
+// ========================================================================================================
+#include "Bench.h"
+#include "Tetrahedron.h"
+#include "ConvexPolyhedron.h"
+#include "Sphere.h"
+#include "MCDriver.h"
+
+using namespace std;
+
+// A driver with the default run parameters of ./main, settled with a few thousand moves so it is past the
+// initial placement
+template <class ShapeType=Tetrahedron>
+static MCDriver<ShapeType> *MakeDriver(int n_particles, Real p_cell_move)
+{
+    MCDriver<ShapeType> *d = new MCDriver<ShapeType>(n_particles, RNG(42, 1), p_cell_move);
+    d->BetaP = 100;
+    d->SetCellShapeDelta(0.02);
+    d->SetParticleTranslationDelta(0.02);
+
+    for(int i=0;i<5000;i++)
+        d->MakeMove();
+
+    return d;
+}
+
+static void BM_MakeMove_Particle(bench::State &state)
+{
+    MCDriver<Tetrahedron> *d = MakeDriver(state.range(0), 0);
+
+    for(auto _ : state)
+        bench::DoNotOptimize(d->MakeMove());
+
+    state.SetItemsProcessed(state.iterations());
+    delete d;
+}
+BENCHMARK(BM_MakeMove_Particle)->Arg(4)->Arg(64)->Arg(512);
+
+static void BM_MakeMove_Cell(bench::State &state)
+{
+    MCDriver<Tetrahedron> *d = MakeDriver(state.range(0), 1);
+
+    for(auto _ : state)
+        bench::DoNotOptimize(d->MakeMove());
+
+    state.SetItemsProcessed(state.iterations());
+    delete d;
+}
+BENCHMARK(BM_MakeMove_Cell)->Arg(4)->Arg(64)->Arg(512);
+
+static void BM_MakeMove_Octahedron(bench::State &state)
+{
+    ConvexPolyhedron::SetBody(ConvexPolyhedron::Octahedron());
+    MCDriver<ConvexPolyhedron> *d = MakeDriver<ConvexPolyhedron>(state.range(0), 0);
+
+    for(auto _ : state)
+        bench::DoNotOptimize(d->MakeMove());
+
+    state.SetItemsProcessed(state.iterations());
+    delete d;
+}
+BENCHMARK(BM_MakeMove_Octahedron)->Arg(4)->Arg(64)->Arg(512);
+
+// Hard spheres on a simple cubic lattice with spacing 1.1 (packing fraction ~0.39) in a cubic cell of k^3 particles.
+// The reference system: k = 2 takes the minimum image path of MCDriver<Sphere>::CollisionDetectedWith, larger
+// cells the cell list.
+static MCDriver<Sphere> *MakeSphereLattice(int k)
+{
+    MCDriver<Sphere> *d = MakeDriver<Sphere>(k*k*k, 0);
+    d->cell.SetTensor(1.1*k*Matrix::Identity());
+    d->cell_list.SetCell(d->cell.GetFaceHeights());
+
+    uint i = 0;
+    ParticleStore::Pose pose;
+    for(int a=0;a<k;a++)
+    for(int b=0;b<k;b++)
+    for(int c=0;c<k;c++,i++)
+    {
+        d->particles.GetPose(i, pose);
+        pose.s = Vector(a + .5, b + .5, c + .5) / k;
+        d->particles.SetPose(i, pose);
+        d->cell_list.Update(i, d->cell.WrapShape(i));
+    }
+
+    return d;
+}
+
+static void BM_MakeMove_Sphere(bench::State &state)
+{
+    MCDriver<Sphere> *d = MakeSphereLattice(state.range(0));
+
+    for(auto _ : state)
+        bench::DoNotOptimize(d->MakeMove());
+
+    state.SetItemsProcessed(state.iterations());
+    delete d;
+}
+BENCHMARK(BM_MakeMove_Sphere)->Arg(2)->Arg(4)->Arg(8);
+
+// Decorrelation per CPU second of dense hard spheres (k = 4 lattice above): each iteration is a sweep of N moves,
+// either Metropolis particle moves or event chains of length 1, and the items are the mean squared displacement
+// the sweep added. Displacements are unwrapped sweep by sweep with the minimum image, so items/s is ~6x the
+// self diffusion coefficient per second of CPU time.
+static void RunDecorrelation(bench::State &state, MCDriver<Sphere> *d)
+{
+    uint n = d->particles.Size();
+    std::vector<Vector> before(n);
+    Real msd = 0;
+
+    for(auto _ : state)
+    {
+        for(uint i=0;i<n;i++)
+            before[i] = d->particles.GetCOM(i);
+
+        for(uint i=0;i<n;i++)
+            bench::DoNotOptimize(d->MakeMove());
+
+        for(uint i=0;i<n;i++)
+        {
+            Vector s = d->cell.GetInverse() * (d->particles.GetCOM(i) - before[i]);
+            s = s - Vector(round(s[0]), round(s[1]), round(s[2]));
+            msd += (d->cell.h * s).squaredNorm() / n;
+        }
+    }
+
+    state.SetItemsProcessed(msd);
+    delete d;
+}
+
+static void BM_Decorrelation_Metropolis(bench::State &state)
+{
+    MCDriver<Sphere> *d = MakeSphereLattice(4);
+    d->SetParticleTranslationDelta(0.1);
+    RunDecorrelation(state, d);
+}
+BENCHMARK(BM_Decorrelation_Metropolis);
+
+static void BM_Decorrelation_EventChain(bench::State &state)
+{
+    MCDriver<Sphere> *d = MakeSphereLattice(4);
+    d->p_event_chain = 1;
+    d->SetEventChainLength(1);
+    RunDecorrelation(state, d);
+}
+BENCHMARK(BM_Decorrelation_EventChain);
+
+// 16^3 = 4096 tetrahedra in one orientation on an orthorhombic lattice just wider than their bounding boxes
+// (packing fraction ~0.16), swept with MakeMoves: argument 0 is the serial MakeMove loop, n > 0 checkerboard
+// sweeps on n threads. Items are particle moves.
+static void BM_MakeMoves_Checkerboard(bench::State &state)
+{
+    const int k = 16;
+    const Vector spacing(1.01, 1.01, 0.72);
+    MCDriver<Tetrahedron> *d = MakeDriver(k*k*k, 0);
+    d->cell.SetTensor((k*spacing).asDiagonal());
+    d->cell_list.SetCell(d->cell.GetFaceHeights());
+
+    uint i = 0;
+    ParticleStore::Pose pose;
+    pose.q = Quaternion(1, 0, 0, 0);
+    for(int a=0;a<k;a++)
+    for(int b=0;b<k;b++)
+    for(int c=0;c<k;c++,i++)
+    {
+        pose.s = Vector(a + .5, b + .5, c + .5) / k;
+        d->particles.SetPose(i, pose);
+        d->cell_list.Update(i, d->cell.WrapShape(i));
+    }
+
+    ThreadPool pool(std::max(1, (int)state.range(0)));
+    if (state.range(0) > 0)
+        d->pool = &pool;
+
+    for(auto _ : state)
+        d->MakeMoves(k*k*k);
+
+    state.SetItemsProcessed(state.iterations()*k*k*k);
+    delete d;
+}
+BENCHMARK(BM_MakeMoves_Checkerboard)->Arg(0)->Arg(1)->Arg(4)->Arg(32);
+
+static void BM_CollisionDetectedWith(bench::State &state)
+{
+    MCDriver<Tetrahedron> *d = MakeDriver(state.range(0), 0);
+    uint n = d->particles.Size();
+
+    uint i = 0;
+    for(auto _ : state)
+    {
+        bench::DoNotOptimize(d->CollisionDetectedWith(i, d->cell_list.coords[i], d->stats));
+        i = (i + 1 == n) ? 0 : i + 1;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    delete d;
+}
+BENCHMARK(BM_CollisionDetectedWith)->Arg(4)->Arg(64)->Arg(512);
@@ -0,0 +1,55 @@
+// ========================================================================================================
+// Cell benchmarks: fractional coordinates and periodic wrapping. Items are particles.
+// ========================================================================================================
+#include "Bench.h"
+#include "Cell.h"
+#include "Tetrahedron.h"
+
+using namespace std;
+
+const int N_POINTS = 1024;
+
+// A sheared cell (so h is not diagonal) holding N_POINTS tetrahedra scattered over a few periodic images
+struct ScatteredCell
+{
+    Cell cell;
+    ParticleStore store;
+
+    ScatteredCell(): cell(8), store(Tetrahedron::GetBodyVertices())
+    {
+        RNG rng(99);
+        Matrix h = this->cell.h;
+        h(0,1) = 1.5;
+        h(0,2) = -0.5;
+        h(1,2) = 2.0;
+        this->cell.SetTensor(h);
+        this->cell.SetParticles(&this->store);
+
+        for(int i=0;i<N_POINTS;i++)
+            this->store.Add(Vector(rng.u(-16, 24), rng.u(-16, 24), rng.u(-16, 24)), rng.Orientation());
+    }
+};
+
+static void BM_PartialCoords(bench::State &state)
+{
+    ScatteredCell c;
+
+    for(auto _ : state)
+        for(uint i=0;i<N_POINTS;i++)
+            bench::DoNotOptimize(c.cell.PartialCoords(c.store.GetCOM(i)));
+
+    state.SetItemsProcessed(1.0 * state.iterations() * N_POINTS);
+}
+BENCHMARK(BM_PartialCoords);
+
+static void BM_WrapShape(bench::State &state)
+{
+    ScatteredCell c;
+
+    for(auto _ : state)
+        for(uint i=0;i<N_POINTS;i++)
+            bench::DoNotOptimize(c.cell.WrapShape(i));
+
+    state.SetItemsProcessed(1.0 * state.iterations() * N_POINTS);
+}
+BENCHMARK(BM_WrapShape);
@@ -0,0 +1,175 @@
+// ========================================================================================================
+// Narrow-phase benchmarks: one tetrahedron tested against a fixed set of candidates that are overlapping,
+// near misses (inside the bounding sphere but disjoint - the common case after the broad phase) or far
+// (outside the bounding sphere). Items are candidate pairs.
+// ========================================================================================================
+#include "Bench.h"
+#include "Tetrahedron.h"
+#include "ConvexPolyhedron.h"
+#include "Collision.h"
+
+using namespace std;
+
+enum PairKind { OVERLAPPING = 0, NEAR = 1, FAR = 2 };
+
+const int N_PAIRS = 4096;
+
+// Particle 0 of `store` is tested against particles 1..N_PAIRS
+struct PairSet
+{
+    ParticleStore store;
+    PairSet(): store(Tetrahedron::GetBodyVertices()) {}
+};
+
+static PairSet &GetPairs(int kind)
+{
+    static PairSet *sets[3] = {NULL, NULL, NULL};
+    if (sets[kind])
+        return *sets[kind];
+
+    PairSet *p = new PairSet();
+    RNG rng(1234 + kind);
+
+    p->store.Add(Vector(0,0,0), rng.Orientation());
+    Tetrahedron t(&p->store, 0);
+
+    Real R = Tetrahedron::GetCircumradius();
+    while(p->store.Size() < N_PAIRS + 1)
+    {
+        Real reach = (kind == FAR) ? 3*R : 2*R;
+        Vector r(rng.u(-reach, reach), rng.u(-reach, reach), rng.u(-reach, reach));
+        Quaternion q = rng.Orientation();
+
+        // Keep the candidate only if it is of the requested kind
+        ParticleStore trial(Tetrahedron::GetBodyVertices());
+        trial.Add(r, q);
+        Tetrahedron c(&trial, 0);
+
+        bool keep;
+        if (kind == FAR)
+            keep = r.norm() > 2*R && r.norm() < 3*R;
+        else
+            keep = r.norm() < 2*R && t.IntersectsSAT(&c, Vector(0,0,0)) == (kind == OVERLAPPING);
+
+        if (keep)
+            p->store.Add(r, q);
+    }
+
+    sets[kind] = p;
+    return *p;
+}
+
+// Tetrahedron::Intersects (bounding sphere + the selected kernel) - arg is the PairKind
+static void BM_TetrahedronIntersects(bench::State &state)
+{
+    PairSet &p = GetPairs(state.range(0));
+    Tetrahedron t(&p.store, 0);
+    Vector zero(0,0,0);
+
+    for(auto _ : state)
+        for(uint j=1;j<=N_PAIRS;j++)
+        {
+            Tetrahedron c(&p.store, j);
+            bench::DoNotOptimize(t.Intersects(&c, zero));
+        }
+
+    state.SetItemsProcessed(1.0 * state.iterations() * N_PAIRS);
+}
+BENCHMARK(BM_TetrahedronIntersects)->Arg(OVERLAPPING)->Arg(NEAR)->Arg(FAR);
+
+// ConvexPolyhedron::Intersects (GJK) on the same tetrahedron pairs, with the regular tetrahedron as the body
+static void BM_PolyhedronIntersects(bench::State &state)
+{
+    PairSet &p = GetPairs(state.range(0));
+    ConvexPolyhedron::SetBody(ConvexPolyhedron::RegularTetrahedron());
+    ConvexPolyhedron t(&p.store, 0);
+    Vector zero(0,0,0);
+
+    for(auto _ : state)
+        for(uint j=1;j<=N_PAIRS;j++)
+        {
+            ConvexPolyhedron c(&p.store, j);
+            bench::DoNotOptimize(t.Intersects(&c, zero));
+        }
+
+    state.SetItemsProcessed(1.0 * state.iterations() * N_PAIRS);
+}
+BENCHMARK(BM_PolyhedronIntersects)->Arg(OVERLAPPING)->Arg(NEAR)->Arg(FAR);
+
+static void BM_IntersectsTriangles(bench::State &state)
+{
+    PairSet &p = GetPairs(NEAR);
+    Tetrahedron t(&p.store, 0);
+    Vector zero(0,0,0);
+
+    for(auto _ : state)
+        for(uint j=1;j<=N_PAIRS;j++)
+        {
+            Tetrahedron c(&p.store, j);
+            bench::DoNotOptimize(t.IntersectsTriangles(&c, zero));
+        }
+
+    state.SetItemsProcessed(1.0 * state.iterations() * N_PAIRS);
+}
+BENCHMARK(BM_IntersectsTriangles);
+
+static void BM_IntersectsSAT(bench::State &state)
+{
+    PairSet &p = GetPairs(NEAR);
+    Tetrahedron t(&p.store, 0);
+    Vector zero(0,0,0);
+
+    for(auto _ : state)
+        for(uint j=1;j<=N_PAIRS;j++)
+        {
+            Tetrahedron c(&p.store, j);
+            bench::DoNotOptimize(t.IntersectsSAT(&c, zero));
+        }
+
+    state.SetItemsProcessed(1.0 * state.iterations() * N_PAIRS);
+}
+BENCHMARK(BM_IntersectsSAT);
+
+// Batched SAT (TetraBatch) on near misses - arg 0 forces the scalar kernel, arg 1 uses AVX2 if available
+static void BM_TetraBatch(bench::State &state)
+{
+    PairSet &p = GetPairs(NEAR);
+    Tetrahedron t(&p.store, 0);
+    Vector zero(0,0,0);
+
+    bool use_avx2 = TetraBatch::use_avx2;
+    TetraBatch::use_avx2 = use_avx2 && state.range(0);
+
+    for(auto _ : state)
+    {
+        TetraBatch batch(t);
+        bool hit = false;
+        for(uint j=1;j<=N_PAIRS;j++)
+            if (batch.Add(j, zero))
+                hit |= batch.Flush();
+        hit |= batch.Flush();
+        bench::DoNotOptimize(hit);
+    }
+
+    TetraBatch::use_avx2 = use_avx2;
+    state.SetItemsProcessed(1.0 * state.iterations() * N_PAIRS);
+}
+BENCHMARK(BM_TetraBatch)->Arg(0)->Arg(1);
+
+// tr_tri_intersect3D on the first face of each near-miss candidate against the first face of particle 0
+static void BM_TriTriIntersect(bench::State &state)
+{
+    PairSet &p = GetPairs(NEAR);
+
+    vector<Triangle> faces;
+    for(uint j=0;j<=N_PAIRS;j++)
+        faces.push_back(Triangle(p.store.GetVertex(j, 0), p.store.GetVertex(j, 1), p.store.GetVertex(j, 2)));
+
+    for(auto _ : state)
+        for(uint j=1;j<=N_PAIRS;j++)
+            bench::DoNotOptimize(tr_tri_intersect3D(faces[0].vertex, faces[0].edge1, faces[0].edge2,
+                                                    faces[j].vertex, faces[j].edge1, faces[j].edge2));
+
+    state.SetItemsProcessed(1.0 * state.iterations() * N_PAIRS);
+}
+BENCHMARK(BM_TriTriIntersect);
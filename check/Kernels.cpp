@@ -0,0 +1,227 @@
+// ========================================================================================================
+// Narrow-phase cross-checks: every tetrahedron overlap kernel against the double precision separating axis
+// test (Tetrahedron::IntersectsSAT), on random pairs inside the bounding sphere and on pairs placed within
+// round-off of contact. Candidates sit behind a random periodic offset, so the offset paths are covered too.
+//
+//   triangles      Tetrahedron::IntersectsTriangles (4x4 triangle-triangle tests)
+//   batch          TetraBatch::Flush (single precision SAT) - errs on the side of an overlap
+//   batch x8       a full batch of WIDTH candidates against the same candidates flushed one at a time
+//   avx2/scalar    the two TetraBatch kernels, per candidate and per full batch - must agree bit for bit
+//   gjk            ConvexPolyhedron::Intersects with the regular tetrahedron as the body
+//
+// A disagreement with the reference is only tolerated if the pair is within MARGIN of contact: moving the
+// candidate MARGIN along the center line (apart if the reference sees an overlap, closer if it doesn't) flips the
+// reference answer. The batch kernel may not miss any overlap, and the avx2 and scalar kernels may not disagree
+// at all. Run as `bin/check_Kernels [n_pairs N] [seed S]`; the exit code is non-zero on a failure.
+// ========================================================================================================
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include "Tetrahedron.h"
+#include "ConvexPolyhedron.h"
+
+using namespace std;
+
+// Pairs per particle store (particle 0 is tested against the rest)
+const int BLOCK = 4096;
+
+// Contact tolerance (unit edges) - well above the single precision round-off of the vertex coordinates
+const double MARGIN = 1e-5;
+
+struct Tally
+{
+    string name;
+    long pairs, disagreements, tolerated, failures;
+
+    Tally(string name): name(name), pairs(0), disagreements(0), tolerated(0), failures(0) {}
+
+    void Print()
+    {
+        cout << left << setw(14) << name << right << setw(12) << pairs << setw(15) << disagreements
+             << setw(12) << tolerated << setw(10) << failures << endl;
+    }
+};
+
+// Does the reference answer flip within MARGIN of the candidate's position along the center line?
+static bool NearContact(Tetrahedron &t, Tetrahedron &c, const Vector &offset, bool reference)
+{
+    Vector u = (c.GetCOM() + offset - t.GetCOM()).normalized();
+    Vector shift = (reference ? MARGIN : -MARGIN)*u;
+    return t.IntersectsSAT(&c, offset + shift) != reference;
+}
+
+// Compare `result` with the reference: count it, and return whether it is a failure. A false overlap is tolerated 
+// if `near_contact`, a missed one if `near_miss`.
+static bool Compare(Tally &tally, bool result, bool reference, bool near_contact, bool near_miss)
+{
+    tally.pairs++;
+    if (result == reference)
+        return false;
+
+    tally.disagreements++;
+    if (result ? near_contact : near_miss)
+    {
+        tally.tolerated++;
+        return false;
+    }
+
+    tally.failures++;
+    return true;
+}
+
+// Particle 0 at the origin, then BLOCK candidates: the even ones anywhere inside the bounding sphere, the odd ones
+// at contact (found by bisection along a random direction) up to a few ulps. Candidate j is stored at its
+// position minus offsets[j].
+static void MakeBlock(ParticleStore &store, vector<Vector> &offsets, RNG &rng)
+{
+    double R = Tetrahedron::GetCircumradius();
+    store.Add(Vector(0,0,0), rng.Orientation());
+    Tetrahedron t(&store, 0);
+
+    offsets.assign(1, Vector(0,0,0));
+    for(int j=1;j<=BLOCK;j++)
+    {
+        Vector offset(2*rng.Index(5) - 4, 2*rng.Index(5) - 4, 2*rng.Index(5) - 4);
+        Vector r;
+        uint k = store.Add(Vector(0,0,0), rng.Orientation());
+
+        if (j % 2 == 0)
+        {
+            do
+                r = Vector(rng.u(-2*R, 2*R), rng.u(-2*R, 2*R), rng.u(-2*R, 2*R));
+            while(r.norm() > 2*R);
+        }
+        else
+        {
+            // Same center always overlaps, 2R apart never does
+            Tetrahedron c(&store, k);
+            Vector u = rng.Orientation() * Vector(1, 0, 0);
+            double lo = 0, hi = 2*R;
+            for(int it=0;it<60;it++)
+            {
+                double mid = .5*(lo + hi);
+                if (t.IntersectsSAT(&c, mid*u))
+                    lo = mid;
+                else
+                    hi = mid;
+            }
+            r = (lo + rng.u(-1e-6, 1e-6))*u;
+        }
+
+        store.Translate(k, r - offset);
+        offsets.push_back(offset);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    long n_pairs = 1000000;
+    uint64_t seed = 1;
+    for(int i=1;i+1<argc;i+=2)
+    {
+        string key = argv[i];
+        if (key == "n_pairs")
+            n_pairs = atol(argv[i+1]);
+        else if (key == "seed")
+            seed = strtoull(argv[i+1], NULL, 10);
+        else
+        {
+            cout << "Error: Unknown option " << key << " (valid choices: n_pairs, seed)" << endl;
+            return 2;
+        }
+    }
+
+    RNG rng(seed);
+    ConvexPolyhedron::SetBody(ConvexPolyhedron::RegularTetrahedron());
+    Tetrahedron::overlap_kernel = Tetrahedron::SAT;
+    bool has_avx2 = TetraBatch::use_avx2;
+    if (!has_avx2)
+        cout << "Note: no AVX2 on this host, avx2/scalar only runs the scalar kernel" << endl;
+
+    Tally triangles("triangles"), batch("batch"), full_batch("batch x8"), lanes("avx2/scalar"), full_lanes("avx2/scalar x8");
+    Tally gjk("gjk");
+    bool failed = false, reported = false;
+
+    for(long done=0;done<n_pairs;done+=BLOCK)
+    {
+        ParticleStore store(Tetrahedron::GetBodyVertices());
+        vector<Vector> offsets;
+        MakeBlock(store, offsets, rng);
+
+        Tetrahedron t(&store, 0);
+        ConvexPolyhedron p(&store, 0);
+        vector<bool> scalar(BLOCK + 1);
+
+        for(int j=1;j<=BLOCK;j++)
+        {
+            Tetrahedron c(&store, j);
+            ConvexPolyhedron q(&store, j);
+            const Vector &offset = offsets[j];
+
+            bool ref = t.IntersectsSAT(&c, offset);
+            bool near_contact = NearContact(t, c, offset, ref);
+
+            bool tri = t.IntersectsTriangles(&c, offset);
+            failed |= Compare(triangles, tri, ref, near_contact, near_contact);
+
+            TetraBatch::use_avx2 = false;
+            TetraBatch b(t);
+            b.Add(j, offset);
+            scalar[j] = b.Flush();
+            failed |= Compare(batch, scalar[j], ref, near_contact, false);
+
+            TetraBatch::use_avx2 = has_avx2;
+            TetraBatch b2(t);
+            b2.Add(j, offset);
+            failed |= Compare(lanes, b2.Flush(), scalar[j], false, false);
+
+            failed |= Compare(gjk, p.Intersects(&q, offset), ref, near_contact, near_contact);
+
+            if (failed && !reported)
+            {
+                reported = true;
+                cout << "First failure: pair " << done + j << " of seed " << seed << endl
+                     << store.ToString(0) << endl << store.ToString(j) << endl
+                     << "offset " << offset.transpose() << ", reference " << ref << endl;
+            }
+        }
+
+        // Full batches: lanes are evaluated together, the answer is whether any of them overlaps
+        for(int j0=1;j0+TetraBatch::WIDTH-1<=BLOCK;j0+=TetraBatch::WIDTH)
+        {
+            bool any_scalar = false;
+            TetraBatch::use_avx2 = false;
+            TetraBatch b(t);
+            for(int j=j0;j<j0+TetraBatch::WIDTH;j++)
+            {
+                b.Add(j, offsets[j]);
+                any_scalar |= scalar[j];
+            }
+            bool full_scalar = b.Flush();
+
+            TetraBatch::use_avx2 = has_avx2;
+            TetraBatch b2(t);
+            for(int j=j0;j<j0+TetraBatch::WIDTH;j++)
+                b2.Add(j, offsets[j]);
+            bool full = b2.Flush();
+
+            failed |= Compare(full_batch, full_scalar, any_scalar, false, false);
+            failed |= Compare(full_lanes, full, full_scalar, false, false);
+        }
+    }
+    TetraBatch::use_avx2 = has_avx2;
+
+    cout << left << setw(14) << "kernel" << right << setw(12) << "pairs" << setw(15) << "disagreements"
+         << setw(12) << "tolerated" << setw(10) << "failures" << endl;
+    triangles.Print();
+    batch.Print();
+    full_batch.Print();
+    lanes.Print();
+    full_lanes.Print();
+    gjk.Print();
+
+    cout << (failed ? "FAILED" : "OK") << endl;
+    return failed ? 1 : 0;
+}
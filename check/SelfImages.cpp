@@ -0,0 +1,110 @@
+// ========================================================================================================
+// Self-image regression check: a single tetrahedron in thin, long cells. The thin direction is less than a
+// cutoff high (so it has 1 bin and several image shells) and the long ones have 3+ bins. The particle sits near
+// the x boundary and the trial moves are pushed across it, so the trial usually wraps into a different bin than
+// the one the cell list still has the particle in. Every trial is checked against the particle's own images with
+// MCDriver::CollisionDetectedWith and by brute force over all images h*m with |m_d| <= 4 using the double
+// precision SAT. A self-overlap the driver misses fails the check (false overlaps within round-off of contact are
+// only counted). Run as `bin/check_SelfImages [n_trials N] [seed S]`; the exit code is non-zero on a failure.
+// ========================================================================================================
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include "MCDriver.h"
+#include "Tetrahedron.h"
+
+using namespace std;
+
+const int MAX_IMAGE = 4;
+
+static bool BruteForce(Tetrahedron &t, const Matrix &h)
+{
+    for(int a=-MAX_IMAGE;a<=MAX_IMAGE;a++)
+    for(int b=-MAX_IMAGE;b<=MAX_IMAGE;b++)
+    for(int c=-MAX_IMAGE;c<=MAX_IMAGE;c++)
+        if ((a != 0 || b != 0 || c != 0) && t.IntersectsSAT(&t, h * Vector(a, b, c)))
+            return true;
+
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    long n_trials = 200000;
+    uint64_t seed = 1;
+    for(int i=1;i+1<argc;i+=2)
+    {
+        string key = argv[i];
+        if (key == "n_trials")
+            n_trials = atol(argv[i+1]);
+        else if (key == "seed")
+            seed = strtoull(argv[i+1], NULL, 10);
+        else
+        {
+            cout << "Error: Unknown option " << key << " (valid choices: n_trials, seed)" << endl;
+            return 2;
+        }
+    }
+
+    RNG rng(seed);
+    Tetrahedron::overlap_kernel = Tetrahedron::SAT;
+
+    // Thin direction y (heights from well inside the particle to just above its smallest width), with and
+    // without a shear of the long directions
+    const double thin[] = {0.5, 0.75, 0.9, 1.1};
+    long overlapping = 0, missed = 0, false_overlaps = 0;
+
+    for(int shape=0;shape<8;shape++)
+    {
+        MCDriver<Tetrahedron> d(1, RNG(seed, shape + 1));
+
+        Matrix h = Matrix::Zero();
+        h(0,0) = 6;
+        h(1,1) = thin[shape % 4];
+        h(2,2) = 5;
+        if (shape >= 4)
+        {
+            h(0,2) = 1.5;
+            h(1,0) = 0.2;
+        }
+        d.cell.SetTensor(h);
+        d.cell_list.SetCell(d.cell.GetFaceHeights());
+
+        int y_shells = d.cell_list.n_shells[1];
+        if (d.cell_list.n_bins[0] < 3 || d.cell_list.n_bins[1] >= 3 || !d.cell_list.Covers(d.cell.GetFaceHeights()))
+        {
+            cout << "Error: cell " << shape << " doesn't have the bin layout under test" << endl;
+            return 2;
+        }
+
+        uint trial = d.particles.GetTrial(0);
+        for(long k=0;k<n_trials/8;k++)
+        {
+            // Particle 0 just below the x boundary, the trial up to half a bin across it
+            d.particles.SetFractional(0, Vector(rng.u(.9, 1), rng.u(0, 1), rng.u(0, 1)));
+            d.particles.Rotate(0, rng.Orientation());
+            d.cell_list.Update(0, d.cell.WrapShape(0));
+
+            d.particles.Copy(0, trial);
+            d.particles.Translate(trial, h.col(0) * rng.u(0, .2));
+            d.particles.Rotate(trial, Quaternion(1, rng.u(-.1, .1), rng.u(-.1, .1), rng.u(-.1, .1)).normalized());
+            Vector s = d.cell.WrapShape(trial);
+
+            Tetrahedron t(&d.particles, trial);
+            bool reference = BruteForce(t, h);
+            bool detected = d.CollisionDetectedWith(0, s, d.stats, trial);
+
+            overlapping += reference;
+            missed += reference && !detected;
+            false_overlaps += detected && !reference;
+        }
+
+        cout << "cell " << shape << ": height " << d.cell.GetFaceHeights()[1] << " along y, " << y_shells
+             << " image shells" << endl;
+    }
+
+    cout << n_trials/8*8 << " trials, " << overlapping << " overlapping their own images, " << missed << " missed, "
+         << false_overlaps << " false overlaps" << endl;
+    cout << (missed ? "FAILED" : "OK") << endl;
+    return missed ? 1 : 0;
+}
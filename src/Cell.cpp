@@ -1,33 +1,145 @@
+#include <limits>
 #include "Cell.h"
+#include "Checkpoint.h"
 
 Cell::Cell(int n_particles)
 {
-    this->h.setIdentity();
-    this->h *= n_particles;
+    this->particles = NULL;
+    this->SetTensor(n_particles * Matrix::Identity());
 }
 
-// Return the volume of the cell (det(h))
+// Attach the particles whose (fractional) positions refer to this cell
+void Cell::SetParticles(ParticleStore *particles)
+{
+    this->particles = particles;
+    this->particles->SetLattice(this->h, this->h_inv);
+}
+
+// Replace the cell tensor and refresh everything derived from it - the one 3x3 inverse per cell change. The
+// particles keep their fractional coordinates, i.e. they are carried along by the deformation.
+void Cell::SetTensor(const Matrix &h)
+{
+    this->h = h;
+    this->det = h.determinant();
+    this->volume = std::abs(this->det);
+    this->h_inv = h.inverse();
+
+    if (this->particles != NULL)
+        this->particles->SetLattice(this->h, this->h_inv);
+}
+
+// Return the volume of the cell (|det(h)|)
 Real Cell::GetVolume()
 {
-    return std::abs(this->h.determinant());
+    return this->volume;
+}
+
+double Cell::GetDeterminant()
+{
+    return this->det;
+}
+
+const Matrix &Cell::GetInverse()
+{
+    return this->h_inv;
+}
+
+// Return the distance between each pair of opposite faces of the cell (V / |a_j x a_k| for face (j,k))
+Vector Cell::GetFaceHeights()
+{
+    Real V = this->GetVolume();
+    Vector heights;
+    for(int i=0;i<3;i++)
+        heights[i] = V / this->h.col((i+1)%3).cross(this->h.col((i+2)%3)).norm();
+
+    return heights;
+}
+
+// ========================================================================================================
+// Reduce - Greedy lattice reduction: shorten each cell vector by integer multiples of the others (Lagrange/Gauss
+// steps) and by the sums/differences of the other two, until none of them gets any shorter. Every step adds an
+// integer multiple of one basis vector to another, so the lattice, the determinant and the handedness stay the
+// same. Each accepted step strictly shortens a vector, so this terminates. Short vectors mean large face heights,
+// so the cell list keeps its bins and the collision checks need few periodic images however far the cell has 
+// been sheared. The particles stay where they are in space: their fractional coordinates are carried over to the
+// new basis and wrapped into it.
+// ========================================================================================================
+bool Cell::Reduce()
+{
+    // Only steps that gain more than a few single precision ulps count, so equal-length alternatives (within the 
+    // round-off of the float particle data the cell is used with) can't cycle. The basis itself is in double.
+    const double EPS = 4*std::numeric_limits<Real>::epsilon();
+
+    Matrix b = this->h;
+    bool changed = false;
+    for(int pass=0;pass<100;pass++)
+    {
+        bool improved = false;
+
+        for(int i=0;i<3;i++)
+        for(int j=0;j<3;j++)
+        {
+            if (i == j)
+                continue;
+
+            double r = b.col(i).dot(b.col(j)) / b.col(j).squaredNorm();
+            if (std::abs(r) > 0.5 + EPS)
+            {
+                b.col(i) -= round(r)*b.col(j);
+                improved = true;
+            }
+        }
+
+        // Pairwise reduced bases can still have a_i -/+ (a_j +/- a_k) shorter than a_i
+        for(int i=0;i<3;i++)
+        for(int sign=-1;sign<=1;sign+=2)
+        {
+            Vector c = b.col((i+1)%3) + sign*b.col((i+2)%3);
+            for(int k=-1;k<=1;k+=2)
+                if ((b.col(i) + k*c).squaredNorm() < (1 - EPS)*b.col(i).squaredNorm())
+                {
+                    b.col(i) += k*c;
+                    improved = true;
+                }
+        }
+
+        if (!improved)
+            break;
+        changed = true;
+    }
+
+    if (!changed)
+        return false;
+
+    // h_new = h_old U for an integer matrix U, so s_new = U^-1 s_old exactly (rounding removes the round-off)
+    Matrix u_inv = b.inverse() * this->h;
+    for(int i=0;i<3;i++)
+        for(int j=0;j<3;j++)
+            u_inv(i,j) = round(u_inv(i,j));
+    this->SetTensor(b);
+
+    if (this->particles != NULL)
+        for(uint i=0;i<this->particles->Size();i++)
+            this->particles->SetFractional(i, Cell::WrapCoords(u_inv * this->particles->GetFractional(i)));
+
+    return true;
 }
 
 // Take a vector in R^3 and return its partial coordinates in the unit cell's reference (S^3: [{0,1}, {0,1}, {0,1}])
 // v = h <dot> s 
 Vector Cell::PartialCoords(Vector v)
 {
-    Vector s = this->h.colPivHouseholderQr().solve(v);
-    return s;
+    return this->h_inv * v;
 }
 
-// Translate the input Shape so that its center of mass is located within the fundamental cell (applying PBCs)
-void Cell::WrapShape(Shape *t)
+// Translate particle `i` so that its center of mass is located within the fundamental cell (applying PBCs)
+// Returns the wrapped fractional coordinates of the center of mass
+Vector Cell::WrapShape(uint i)
 {
-    Vector old_com = t->GetCOM();
-    Vector com = this->PeriodicImage(t->GetCOM());
-    Vector dr = com - old_com;
+    Vector s = Cell::WrapCoords(this->particles->GetFractional(i));
+    this->particles->SetFractional(i, s);
 
-    t->Translate(dr);
+    return s;
 }
 
 // Return the wrapped representation of the input vector applying periodic boundaries
@@ -36,6 +148,12 @@ Vector Cell::PeriodicImage(Vector v)
     // First, solve h.s = v where s is the transformed, fractional coordinates of the input vector in the unit cell basis (with cell tensor 'h')
     Vector s = this->PartialCoords(v);
 
+    return this->h * Cell::WrapCoords(s);
+}
+
+// Map fractional coordinates back onto the unit cell
+Vector Cell::WrapCoords(Vector s)
+{
     for(uint i=0;i<3;i++)
     {
         s[i] = s[i] - int(s[i]);
@@ -45,7 +163,7 @@ Vector Cell::PeriodicImage(Vector v)
             s[i] += 1;
     }
 
-    return this->h * s;
+    return s;
 }
 
 // Spit out a formatted string representation of this fundamental cell (each line represents a basis vector)
@@ -63,3 +181,15 @@ std::string Cell::ToString()
 
     return s;
 }
+
+void Cell::Save(std::ostream &out)
+{
+    checkpoint::Write(out, this->h);
+}
+
+void Cell::Load(std::istream &in)
+{
+    Matrix h;
+    checkpoint::Read(in, h);
+    this->SetTensor(h);
+}
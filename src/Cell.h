@@ -1,22 +1,43 @@
 #pragma once
 
 #include "Globals.h"
-#include "Shape.h"
+#include "ParticleStore.h"
 
 class Cell
 {
     public:
-    // Cell tensor
+    // Cell tensor - read freely, but change it through SetTensor so the cached inverse/determinant/volume follow
     Matrix h;
-    std::vector<Shape*> particles;
+    ParticleStore *particles;
 
     // Constructor
     Cell(int n);
 
     // Instance Methods
+    void SetParticles(ParticleStore *particles);
+    void SetTensor(const Matrix &h);
     Real GetVolume();
+    double GetDeterminant();
+    const Matrix &GetInverse();
+    Vector GetFaceHeights();
     Vector PartialCoords(Vector v);
     Vector PeriodicImage(Vector v);
+    static Vector WrapCoords(Vector s);
     std::string ToString();
-    void WrapShape(Shape *t);
+    Vector WrapShape(uint i);
+
+    // Replace h by a reduced basis of the same lattice (short, nearly orthogonal cell vectors). The particles
+    // don't move, but their fractional coordinates change (they are rewrapped here), so anything indexed by them
+    // - the cell list - has to be rebuilt if this returns true.
+    bool Reduce();
+
+    // Checkpointing (only h is stored, the rest is derived from it)
+    void Save(std::ostream &out);
+    void Load(std::istream &in);
+
+    private:
+    // Derived from h in SetTensor
+    Matrix h_inv;
+    double det;
+    Real volume;
 };
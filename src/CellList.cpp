@@ -0,0 +1,148 @@
+#include <limits>
+#include "CellList.h"
+#include "Checkpoint.h"
+
+// Taken by reference (std::min), so it needs a definition
+const int CellList::MAX_SHELLS;
+
+CellList::CellList(Real cutoff, int max_bins)
+{
+    this->cutoff = cutoff;
+    this->max_bins = max_bins;
+
+    for(int d=0;d<3;d++)
+    {
+        this->n_bins[d] = 1;
+        this->n_shells[d] = 1;
+    }
+    this->bins.resize(1);
+}
+
+bool CellList::SetCell(Vector heights)
+{
+    int n[3];
+    for(int d=0;d<3;d++)
+    {
+        n[d] = std::max(1, int(heights[d] / this->cutoff));
+
+        // A center closer than `cutoff` is at most ceil(cutoff/height) images away
+        this->n_shells[d] = std::min(MAX_SHELLS, std::max(1, int(ceil(this->cutoff / heights[d]))));
+    }
+
+    // Coarsen the finest direction until we're under the bin budget (wider bins are always valid)
+    while((long long)n[0]*n[1]*n[2] > std::max(27, this->max_bins))
+    {
+        int d = 0;
+        for(int k=1;k<3;k++)
+            if (n[k] > n[d])
+                d = k;
+        n[d]--;
+    }
+
+    if (n[0] == this->n_bins[0] && n[1] == this->n_bins[1] && n[2] == this->n_bins[2])
+        return false;
+
+    for(int d=0;d<3;d++)
+        this->n_bins[d] = n[d];
+    this->Rebuild();
+
+    return true;
+}
+
+bool CellList::Covers(Vector heights)
+{
+    for(int d=0;d<3;d++)
+        if (this->cutoff > MAX_SHELLS*heights[d])
+            return false;
+
+    return true;
+}
+
+void CellList::Rebuild()
+{
+    this->bins.assign(this->n_bins[0]*this->n_bins[1]*this->n_bins[2], std::vector<int>());
+
+    for(uint i=0;i<this->coords.size();i++)
+    {
+        this->bin_of[i] = this->GetBin(this->coords[i]);
+        this->bins[this->bin_of[i]].push_back(i);
+    }
+}
+
+void CellList::Insert(const Vector &s)
+{
+    this->coords.push_back(s);
+    this->bin_of.push_back(this->GetBin(s));
+    this->bins[this->bin_of.back()].push_back(this->coords.size() - 1);
+}
+
+void CellList::Update(int i, const Vector &s)
+{
+    this->coords[i] = s;
+
+    int b = this->GetBin(s);
+    if (b == this->bin_of[i])
+        return;
+
+    // Swap-remove from the old bin, then append to the new one
+    std::vector<int> &old_bin = this->bins[this->bin_of[i]];
+    for(uint k=0;k<old_bin.size();k++)
+        if (old_bin[k] == i)
+        {
+            old_bin[k] = old_bin.back();
+            old_bin.pop_back();
+            break;
+        }
+
+    this->bin_of[i] = b;
+    this->bins[b].push_back(i);
+}
+
+int CellList::GetBinCoord(Real s, int d)
+{
+    int b = int(s * this->n_bins[d]);
+
+    // Guard against round-off at the cell boundary (s = 1 or a hair below 0)
+    if (b < 0)
+        b = 0;
+    if (b >= this->n_bins[d])
+        b = this->n_bins[d] - 1;
+
+    return b;
+}
+
+int CellList::GetBin(const Vector &s)
+{
+    return (this->GetBinCoord(s[0], 0)*this->n_bins[1] + this->GetBinCoord(s[1], 1))*this->n_bins[2] + this->GetBinCoord(s[2], 2);
+}
+
+Real CellList::GetReach(Vector heights)
+{
+    // With 3+ bins we see one bin either side; with fewer we see every bin in n_shells images either side
+    Real reach = std::numeric_limits<Real>::max();
+    for(int d=0;d<3;d++)
+        reach = std::min(reach, Real(this->n_bins[d] >= 3 ? heights[d] / this->n_bins[d] : this->n_shells[d]*heights[d]));
+
+    return reach;
+}
+
+void CellList::Save(std::ostream &out)
+{
+    checkpoint::Write(out, this->n_bins);
+    checkpoint::WriteVector(out, this->coords);
+    checkpoint::WriteVector(out, this->bin_of);
+
+    for(uint b=0;b<this->bins.size();b++)
+        checkpoint::WriteVector(out, this->bins[b]);
+}
+
+void CellList::Load(std::istream &in)
+{
+    checkpoint::Read(in, this->n_bins);
+    checkpoint::ReadVector(in, this->coords);
+    checkpoint::ReadVector(in, this->bin_of);
+
+    this->bins.resize(this->n_bins[0]*this->n_bins[1]*this->n_bins[2]);
+    for(uint b=0;b<this->bins.size();b++)
+        checkpoint::ReadVector(in, this->bins[b]);
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <vector>
+#include "Globals.h"
+
+// ========================================================================================================
+// CellList - Linked-cell spatial index over the fractional coordinates of the particle centers.
+//
+// The unit cell is split into n_bins[0] x n_bins[1] x n_bins[2] bins, each at least `cutoff` wide in
+// Cartesian space (measured along the face heights). Two particles can then only overlap if their bins
+// are neighbors, so the broad phase only visits the 27 bins around a particle. Along a direction with
+// fewer than 3 bins every bin is visited in as many periodic images as the face height requires: the
+// -1/0/+1 images (the old all-pairs + first shell search) as long as the height is at least `cutoff`,
+// more shells for thinner cells.
+// ========================================================================================================
+class CellList
+{
+    public:
+    // Minimum bin width (the largest center-center distance at which two particles can overlap)
+    Real cutoff;
+    // Upper bound on the total number of bins - keeps very dilute (e.g. initial) cells from allocating huge grids
+    int max_bins;
+
+    int n_bins[3];
+    // Periodic images -n_shells..n_shells visited along directions with fewer than 3 bins
+    int n_shells[3];
+    std::vector< std::vector<int> > bins;
+
+    // Largest n_shells (keeps the visit lists on the stack); thinner cells are capped here
+    static const int MAX_SHELLS = 8;
+
+    // Wrapped fractional coordinates and bin of each particle
+    std::vector<Vector> coords;
+    std::vector<int> bin_of;
+
+    CellList(Real cutoff=1, int max_bins=27);
+
+    // Adapt the bin counts to a new cell shape (face heights). Returns true if the bins had to be rebuilt.
+    bool SetCell(Vector heights);
+
+    // False if a cell with these face heights would need more than MAX_SHELLS image shells (SetCell would cap 
+    // them, and overlaps with the images beyond would go unnoticed)
+    bool Covers(Vector heights);
+
+    // Add a particle at wrapped fractional coordinates `s` (indices are assigned in insertion order)
+    void Insert(const Vector &s);
+    // Move particle `i` to wrapped fractional coordinates `s`
+    void Update(int i, const Vector &s);
+
+    int GetBin(const Vector &s);
+
+    // Every particle/image pair whose centers are closer than this (for the given face heights) is visited by
+    // ForEachNeighbor, i.e. pairs that are never visited are at least GetReach() apart
+    Real GetReach(Vector heights);
+
+    // Call f(j, shift) for every particle j (and periodic image `shift`) that could lie within `cutoff` of the
+    // point `s`. Stops early and returns true as soon as f returns true.
+    template <class F>
+    bool ForEachNeighbor(const Vector &s, F f);
+
+    // Call f(shift) for every periodic image of a particle that could lie within `cutoff` of the particle itself:
+    // shifts m != 0 with |m_d| <= n_shells[d] along directions with fewer than 3 bins and m_d = 0 along the others
+    // (a cell with 3+ bins along d is at least 3 cutoffs high). ForEachNeighbor reports the particle's own images
+    // relative to its stored position, so the callers skip it there and test their images here instead. Stops 
+    // early and returns true as soon as f returns true.
+    template <class F>
+    bool ForEachSelfImage(F f);
+
+    // Checkpointing - the bin contents are stored as they are, since their order decides the order neighbors are visited in
+    void Save(std::ostream &out);
+    void Load(std::istream &in);
+
+    private:
+    void Rebuild();
+    int GetBinCoord(Real s, int d);
+};
+
+template <class F>
+bool CellList::ForEachNeighbor(const Vector &s, F f)
+{
+    // Per direction, build the list of (bin, image shift) pairs to visit
+    int bin[3][2*(2*MAX_SHELLS + 1)], shift[3][2*(2*MAX_SHELLS + 1)], n_visit[3];
+    for(int d=0;d<3;d++)
+    {
+        int n = this->n_bins[d];
+        n_visit[d] = 0;
+
+        if (n >= 3)
+        {
+            int b0 = this->GetBinCoord(s[d], d);
+            for(int off=-1;off<2;off++)
+            {
+                int b = b0 + off;
+                int sh = 0;
+                if (b < 0) { b += n; sh = -1; }
+                if (b >= n) { b -= n; sh = 1; }
+
+                bin[d][n_visit[d]] = b;
+                shift[d][n_visit[d]++] = sh;
+            }
+        }
+        else
+        {
+            for(int b=0;b<n;b++)
+            for(int sh=-this->n_shells[d];sh<=this->n_shells[d];sh++)
+            {
+                bin[d][n_visit[d]] = b;
+                shift[d][n_visit[d]++] = sh;
+            }
+        }
+    }
+
+    int image[3];
+    for(int a=0;a<n_visit[0];a++)
+    for(int b=0;b<n_visit[1];b++)
+    for(int c=0;c<n_visit[2];c++)
+    {
+        image[0] = shift[0][a];
+        image[1] = shift[1][b];
+        image[2] = shift[2][c];
+
+        std::vector<int> &members = this->bins[(bin[0][a]*this->n_bins[1] + bin[1][b])*this->n_bins[2] + bin[2][c]];
+        for(uint k=0;k<members.size();k++)
+            if (f(members[k], image))
+                return true;
+    }
+
+    return false;
+}
+
+template <class F>
+bool CellList::ForEachSelfImage(F f)
+{
+    int m_max[3];
+    for(int d=0;d<3;d++)
+        m_max[d] = (this->n_bins[d] < 3) ? this->n_shells[d] : 0;
+
+    int image[3];
+    for(image[0]=-m_max[0];image[0]<=m_max[0];image[0]++)
+    for(image[1]=-m_max[1];image[1]<=m_max[1];image[1]++)
+    for(image[2]=-m_max[2];image[2]<=m_max[2];image[2]++)
+    {
+        if (image[0] == 0 && image[1] == 0 && image[2] == 0)
+            continue;
+        if (f(image))
+            return true;
+    }
+
+    return false;
+}
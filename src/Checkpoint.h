@@ -0,0 +1,59 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include "Globals.h"
+
+// ========================================================================================================
+// Raw binary (de)serialization helpers for checkpoints. Values are written with their in-memory layout, so
+// a checkpoint is only meant to be read back by the same build on the same platform - that is what makes a
+// restart continue bit for bit. Only use these with plain-old-data types (including fixed size Eigen types).
+// ========================================================================================================
+namespace checkpoint
+{
+
+// File layout version, bump whenever anything that is saved changes
+const uint32_t VERSION = 9;
+const char MAGIC[8] = {'T', 'E', 'T', 'R', 'C', 'K', 'P', 'T'};
+
+template <class T>
+void Write(std::ostream &out, const T &value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <class T>
+void Read(std::istream &in, T &value)
+{
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+// Vectors are stored as their length followed by the elements
+template <class T, class A>
+void WriteVector(std::ostream &out, const std::vector<T, A> &v)
+{
+    uint64_t n = v.size();
+    Write(out, n);
+    if (n > 0)
+        out.write(reinterpret_cast<const char*>(v.data()), n*sizeof(T));
+}
+
+template <class T, class A>
+void ReadVector(std::istream &in, std::vector<T, A> &v)
+{
+    uint64_t n = 0;
+    Read(in, n);
+
+    // A truncated or foreign file shouldn't make us allocate an absurd amount of memory
+    if (!in || n > (1ULL << 32))
+    {
+        in.setstate(std::ios::failbit);
+        return;
+    }
+
+    v.resize(n);
+    if (n > 0)
+        in.read(reinterpret_cast<char*>(v.data()), n*sizeof(T));
+}
+
+}
@@ -0,0 +1,574 @@
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include "ConvexPolyhedron.h"
+#include "Tetrahedron.h"
+
+std::vector<Vector> ConvexPolyhedron::body;
+std::vector<Vector> ConvexPolyhedron::face_normals;
+std::vector<Vector> ConvexPolyhedron::edge_directions;
+Real ConvexPolyhedron::volume = 0;
+Real ConvexPolyhedron::circumradius = 0;
+Real ConvexPolyhedron::inradius = 0;
+
+// Give up on GJK after this many iterations and report an overlap (rejecting a move is always safe)
+static const int GJK_MAX_ITERATIONS = 64;
+
+// Vertex and axis arrays for ContactDistance. One set per thread, since the drivers run their event chains
+// concurrently; they grow to the size the body needs in the first call and are reused after that.
+struct SweepScratch
+{
+    std::vector<Vector> a, b, axes;
+};
+static thread_local SweepScratch sweep_scratch;
+
+// Constructor - handle on particle `index` of `store`
+ConvexPolyhedron::ConvexPolyhedron(ParticleStore *store, uint index): Shape(store, index)
+{
+}
+
+// ========================================================================================================
+// SetBody - Find the hull faces (every plane through 3 vertices with all the others on one side), then the
+//           volume and center of mass by splitting the hull into tetrahedra (collecting the edge directions on
+//           the way), and finally recenter the body on its COM and record the bounding/inscribed sphere radii.
+//           Brute force, but it only runs once.
+// ========================================================================================================
+bool ConvexPolyhedron::SetBody(const std::vector<Vector> &vertices)
+{
+    // Tolerance relative to the size of the body, and drop repeated vertices
+    double scale = 0;
+    for(uint i=0;i<vertices.size();i++)
+        scale = std::max(scale, vertices[i].norm());
+    double eps = 1e-9 * std::max(scale, 1.0);
+
+    std::vector<Vector> v;
+    for(uint i=0;i<vertices.size();i++)
+    {
+        bool repeated = false;
+        for(uint j=0;j<v.size();j++)
+            repeated |= (v[j] - vertices[i]).norm() < eps;
+        if (!repeated)
+            v.push_back(vertices[i]);
+    }
+
+    int n = v.size();
+    if (n < 4)
+        return false;
+
+    // Supporting planes n.x = d (outward unit normal n), one per face
+    std::vector<Vector> normals;
+    std::vector<double> offsets;
+    for(int i=0;i<n;i++)
+    for(int j=i+1;j<n;j++)
+    for(int k=j+1;k<n;k++)
+    {
+        Vector normal = (v[j] - v[i]).cross(v[k] - v[i]);
+        if (normal.norm() < eps)
+            continue;
+        normal.normalize();
+
+        double d = normal.dot(v[i]);
+        double above = 0, below = 0;
+        for(int m=0;m<n;m++)
+        {
+            above = std::max(above, normal.dot(v[m]) - d);
+            below = std::min(below, normal.dot(v[m]) - d);
+        }
+
+        if (above > eps && below < -eps)
+            continue;
+        if (above > eps)
+        {
+            normal = -normal;
+            d = -d;
+        }
+
+        bool known = false;
+        for(uint f=0;f<normals.size();f++)
+            known |= normals[f].dot(normal) > 1 - 1e-9;
+        if (known)
+            continue;
+
+        normals.push_back(normal);
+        offsets.push_back(d);
+    }
+
+    if (normals.size() < 4)
+        return false;
+
+    // Any interior point works as the apex of the tetrahedra below
+    Vector inside(0,0,0);
+    for(int i=0;i<n;i++)
+        inside += v[i] / n;
+
+    // Each face polygon (vertices sorted by angle around the face center) is fanned into triangles, which make
+    // a tetrahedron each with `inside`. Only vertices on some face are kept.
+    double V = 0;
+    Vector com(0,0,0);
+    std::vector<bool> on_hull(n, false);
+    std::vector<Vector> edges;
+    for(uint f=0;f<normals.size();f++)
+    {
+        std::vector<int> face;
+        Vector center(0,0,0);
+        for(int m=0;m<n;m++)
+            if (std::abs(normals[f].dot(v[m]) - offsets[f]) < eps)
+            {
+                face.push_back(m);
+                center += v[m];
+                on_hull[m] = true;
+            }
+        center /= face.size();
+
+        Vector e0 = (v[face[0]] - center).normalized();
+        Vector e1 = normals[f].cross(e0);
+        std::sort(face.begin(), face.end(), [&](int a, int b)
+        {
+            Vector da = v[a] - center, db = v[b] - center;
+            return atan2(e1.dot(da), e0.dot(da)) < atan2(e1.dot(db), e0.dot(db));
+        });
+
+        // Consecutive vertices around the face are its edges (parallel edges only need one direction)
+        for(uint m=0;m<face.size();m++)
+        {
+            Vector e = (v[face[(m+1) % face.size()]] - v[face[m]]).normalized();
+            bool known = false;
+            for(uint k=0;k<edges.size();k++)
+                known |= std::abs(edges[k].dot(e)) > 1 - 1e-9;
+            if (!known)
+                edges.push_back(e);
+        }
+
+        for(uint m=1;m+1<face.size();m++)
+        {
+            Vector a = v[face[0]] - inside, b = v[face[m]] - inside, c = v[face[m+1]] - inside;
+            double dV = std::abs(a.dot(b.cross(c))) / 6;
+            V += dV;
+            com += dV * (inside + (a + b + c)/4);
+        }
+    }
+    com /= V;
+
+    ConvexPolyhedron::body.clear();
+    ConvexPolyhedron::circumradius = 0;
+    for(int i=0;i<n;i++)
+        if (on_hull[i])
+        {
+            ConvexPolyhedron::body.push_back(v[i] - com);
+            ConvexPolyhedron::circumradius = std::max(ConvexPolyhedron::circumradius, (Real)(v[i] - com).norm());
+        }
+
+    ConvexPolyhedron::inradius = std::numeric_limits<Real>::max();
+    for(uint f=0;f<normals.size();f++)
+        ConvexPolyhedron::inradius = std::min(ConvexPolyhedron::inradius, (Real)(offsets[f] - normals[f].dot(com)));
+
+    ConvexPolyhedron::face_normals = normals;
+    ConvexPolyhedron::edge_directions = edges;
+    ConvexPolyhedron::volume = V;
+
+    return true;
+}
+
+std::vector<Vector> ConvexPolyhedron::GetBodyVertices()
+{
+    return ConvexPolyhedron::body;
+}
+
+Real ConvexPolyhedron::GetCircumradius()
+{
+    return ConvexPolyhedron::circumradius;
+}
+
+Real ConvexPolyhedron::GetInradius()
+{
+    return ConvexPolyhedron::inradius;
+}
+
+Real ConvexPolyhedron::GetVolume()
+{
+    return ConvexPolyhedron::volume;
+}
+
+// ====================== GJK ======================
+
+// Vertex of particle `i` furthest along `d` (the support point) relative to its COM, read from the store's vertex
+// cache
+static inline Vector Support(ParticleStore *store, uint i, const Vector &d)
+{
+    int n = store->n_vertices;
+    const double *x = store->vx.data() + i*n, *y = store->vy.data() + i*n, *z = store->vz.data() + i*n;
+
+    int best = 0;
+    double best_dot = d[0]*x[0] + d[1]*y[0] + d[2]*z[0];
+    for(int k=1;k<n;k++)
+    {
+        double dot = d[0]*x[k] + d[1]*y[k] + d[2]*z[k];
+        if (dot > best_dot)
+        {
+            best_dot = dot;
+            best = k;
+        }
+    }
+
+    return Vector(x[best], y[best], z[best]);
+}
+
+// Closest point to the origin on the segment s[0]-s[1]; the simplex is reduced to the closest feature
+static Vector ClosestOnSegment(Vector *s, int &n)
+{
+    Vector a = s[0], ab = s[1] - s[0];
+    double t = -a.dot(ab), l = ab.squaredNorm();
+
+    if (t <= 0)
+    {
+        n = 1;
+        return a;
+    }
+    if (t >= l)
+    {
+        s[0] = s[1]; n = 1;
+        return s[0];
+    }
+
+    return a + ab*(t/l);
+}
+
+// Closest point to the origin on the triangle s[0..2] (Voronoi region tests from Ericson, Real-Time Collision
+// Detection 5.1.5); the simplex is reduced to the closest vertex, edge or the whole face
+static Vector ClosestOnTriangle(Vector *s, int &n)
+{
+    Vector a = s[0], b = s[1], c = s[2];
+    Vector ab = b - a, ac = c - a;
+
+    double d1 = -ab.dot(a), d2 = -ac.dot(a);
+    if (d1 <= 0 && d2 <= 0)
+    {
+        n = 1;
+        return a;
+    }
+
+    double d3 = -ab.dot(b), d4 = -ac.dot(b);
+    if (d3 >= 0 && d4 <= d3)
+    {
+        s[0] = b; n = 1;
+        return b;
+    }
+
+    double vc = d1*d4 - d3*d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0)
+    {
+        s[1] = b; n = 2;
+        return a + ab*(d1/(d1 - d3));
+    }
+
+    double d5 = -ab.dot(c), d6 = -ac.dot(c);
+    if (d6 >= 0 && d5 <= d6)
+    {
+        s[0] = c; n = 1;
+        return c;
+    }
+
+    double vb = d5*d2 - d1*d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0)
+    {
+        s[1] = c; n = 2;
+        return a + ac*(d2/(d2 - d6));
+    }
+
+    double va = d3*d6 - d5*d4;
+    if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0)
+    {
+        s[0] = b; s[1] = c; n = 2;
+        return b + (c - b)*((d4 - d3)/((d4 - d3) + (d5 - d6)));
+    }
+
+    double denom = 1/(va + vb + vc);
+    n = 3;
+    return a + ab*(vb*denom) + ac*(vc*denom);
+}
+
+// Returns true if the tetrahedron s[0..3] contains the origin. Otherwise `v` is set to the closest point on 
+// the faces the origin is beyond and the simplex is reduced to its feature. A flat tetrahedron has every face 
+// checked, so it never counts as containing the origin.
+static bool ClosestOnTetrahedron(Vector *s, int &n, Vector &v)
+{
+    static const int FACES[4][4] = {{0,1,2,3}, {0,1,3,2}, {0,2,3,1}, {1,2,3,0}};
+
+    bool inside = true;
+    double best = std::numeric_limits<double>::max();
+    Vector closest[3];
+    int n_closest = 0;
+
+    for(int f=0;f<4;f++)
+    {
+        Vector a = s[FACES[f][0]], b = s[FACES[f][1]], c = s[FACES[f][2]], opposite = s[FACES[f][3]];
+        Vector normal = (b - a).cross(c - a);
+        if (normal.dot(-a) * normal.dot(opposite - a) > 0)
+            continue;
+
+        inside = false;
+        Vector face[3] = {a, b, c};
+        int m = 3;
+        Vector q = ClosestOnTriangle(face, m);
+        if (q.squaredNorm() < best)
+        {
+            best = q.squaredNorm();
+            v = q;
+            n_closest = m;
+            for(int k=0;k<m;k++)
+                closest[k] = face[k];
+        }
+    }
+
+    if (inside)
+        return true;
+
+    n = n_closest;
+    for(int k=0;k<n;k++)
+        s[k] = closest[k];
+
+    return false;
+}
+
+// ========================================================================================================
+// Intersects - Bounding sphere early-out (and the inscribed sphere early-in), then GJK: keep the point v of a
+//              simplex of Minkowski difference (this - (p2 + offset)) support points closest to the origin, and 
+//              add the support point w furthest along -v until the simplex encloses the origin (overlap) or 
+//              v.w > 0, i.e. the plane through w normal to v separates the origin from the difference
+// ========================================================================================================
+bool ConvexPolyhedron::Intersects(ConvexPolyhedron *p2, const Vector &offset)
+{
+    Vector r = this->GetCOM() - p2->GetCOM() - offset;
+    double r2 = r.squaredNorm();
+    Real R = ConvexPolyhedron::circumradius, r_in = ConvexPolyhedron::inradius;
+
+    if (r2 > 4*R*R)
+        return false;
+    if (r2 < 4*r_in*r_in)
+        return true;
+
+    Vector s[4];
+    int n = 1;
+    s[0] = Support(this->store, this->index, r) - Support(p2->store, p2->index, -r) + r;
+    Vector v = s[0];
+
+    for(int it=0;it<GJK_MAX_ITERATIONS;it++)
+    {
+        // The origin is on the simplex (touching counts as overlapping)
+        if (v.squaredNorm() < 1e-20)
+            return true;
+
+        Vector w = Support(this->store, this->index, -v) - Support(p2->store, p2->index, v) + r;
+        if (w.dot(v) > 0)
+            return false;
+
+        s[n++] = w;
+        if (n == 2)
+            v = ClosestOnSegment(s, n);
+        else if (n == 3)
+            v = ClosestOnTriangle(s, n);
+        else if (ClosestOnTetrahedron(s, n, v))
+            return true;
+    }
+
+    return true;
+}
+
+// ========================================================================================================
+// Clearance - Cheap lower bound on the distance between `this` and `p2` translated by `offset`: the bounding
+//             spheres and the gap between the projections onto the center-center axis and the face normals
+//             of both bodies
+// ========================================================================================================
+Real ConvexPolyhedron::Clearance(ConvexPolyhedron *p2, const Vector &offset)
+{
+    Vector com = this->GetCOM();
+    Vector r = p2->GetCOM() + offset - com;
+    double best = r.norm() - 2*ConvexPolyhedron::circumradius;
+
+    // Projections straight from the vertex caches (as in Support)
+    int n = this->store->n_vertices;
+    const double *xa = this->store->vx.data() + this->index*n, *ya = this->store->vy.data() + this->index*n;
+    const double *za = this->store->vz.data() + this->index*n;
+    const double *xb = p2->store->vx.data() + p2->index*n, *yb = p2->store->vy.data() + p2->index*n;
+    const double *zb = p2->store->vz.data() + p2->index*n;
+
+    auto gap = [&](const Vector &axis)
+    {
+        double min_a, max_a, min_b, max_b;
+        double base = axis.dot(r);
+        min_a = max_a = axis[0]*xa[0] + axis[1]*ya[0] + axis[2]*za[0];
+        min_b = max_b = base + axis[0]*xb[0] + axis[1]*yb[0] + axis[2]*zb[0];
+        for(int k=1;k<n;k++)
+        {
+            double pa = axis[0]*xa[k] + axis[1]*ya[k] + axis[2]*za[k];
+            double pb = base + axis[0]*xb[k] + axis[1]*yb[k] + axis[2]*zb[k];
+            min_a = std::min(min_a, pa); max_a = std::max(max_a, pa);
+            min_b = std::min(min_b, pb); max_b = std::max(max_b, pb);
+        }
+
+        best = std::max(best, std::max(min_b - max_a, min_a - max_b));
+    };
+
+    if (r.squaredNorm() > 0)
+        gap(r.normalized());
+
+    Matrix r_a = this->store->GetOrientation(this->index).toRotationMatrix();
+    Matrix r_b = p2->store->GetOrientation(p2->index).toRotationMatrix();
+    for(uint f=0;f<ConvexPolyhedron::face_normals.size();f++)
+    {
+        gap(r_a * ConvexPolyhedron::face_normals[f]);
+        gap(r_b * ConvexPolyhedron::face_normals[f]);
+    }
+
+    return best;
+}
+
+// ========================================================================================================
+// ContactDistance - Ray cast against the Minkowski difference, whose face normals are among the (rotated) face 
+//                   normals of both bodies and the cross products of their edge directions
+// ========================================================================================================
+Real ConvexPolyhedron::ContactDistance(ConvexPolyhedron *p2, const Vector &offset, const Vector &d)
+{
+    Vector com = this->GetCOM();
+
+    // The bounding spheres have to meet first: the ray has to pass within 2R of the other center
+    Vector r = p2->GetCOM() + offset - com;
+    double along = r.dot(d), R2 = 4*ConvexPolyhedron::circumradius*ConvexPolyhedron::circumradius;
+    if (r.squaredNorm() - along*along > R2 || (along < 0 && r.squaredNorm() > R2))
+        return std::numeric_limits<Real>::max();
+
+    int n = this->store->n_vertices;
+    std::vector<Vector> &a = sweep_scratch.a, &b = sweep_scratch.b, &axes = sweep_scratch.axes;
+    a.resize(n);
+    b.resize(n);
+    for(int k=0;k<n;k++)
+    {
+        a[k] = this->GetVertexOffset(k);
+        b[k] = r + p2->GetVertexOffset(k);
+    }
+
+    Matrix r_a = this->store->GetOrientation(this->index).toRotationMatrix();
+    Matrix r_b = p2->store->GetOrientation(p2->index).toRotationMatrix();
+
+    // clear() keeps the capacity, so this only allocates the first time
+    axes.clear();
+    for(uint f=0;f<ConvexPolyhedron::face_normals.size();f++)
+    {
+        axes.push_back(r_a * ConvexPolyhedron::face_normals[f]);
+        axes.push_back(r_b * ConvexPolyhedron::face_normals[f]);
+    }
+
+    const std::vector<Vector> &e = ConvexPolyhedron::edge_directions;
+    for(uint i=0;i<e.size();i++)
+    for(uint j=0;j<e.size();j++)
+    {
+        Vector axis = (r_a * e[i]).cross(r_b * e[j]);
+        if (axis.squaredNorm() >= 1e-12)
+            axes.push_back(axis);
+    }
+
+    return Shape::SweptContact(a.data(), n, b.data(), n, axes.data(), axes.size(), d);
+}
+
+// ====================== Bodies ======================
+
+std::vector<Vector> ConvexPolyhedron::Octahedron()
+{
+    double a = 1/sqrt(2.0);
+
+    std::vector<Vector> v;
+    for(int d=0;d<3;d++)
+        for(int sign=-1;sign<2;sign+=2)
+        {
+            Vector e(0,0,0);
+            e[d] = sign*a;
+            v.push_back(e);
+        }
+
+    return v;
+}
+
+std::vector<Vector> ConvexPolyhedron::Cube()
+{
+    std::vector<Vector> v;
+    for(int i=0;i<8;i++)
+        v.push_back(Vector((i&1) ? .5 : -.5, (i&2) ? .5 : -.5, (i&4) ? .5 : -.5));
+
+    return v;
+}
+
+// Permutations of (3, 1, 1) with an even number of minus signs (edge length 2 sqrt(2)), scaled to unit edges
+std::vector<Vector> ConvexPolyhedron::TruncatedTetrahedron()
+{
+    double scale = 1/(2*sqrt(2.0));
+
+    std::vector<Vector> v;
+    for(int p=0;p<3;p++)
+        for(int signs=0;signs<8;signs++)
+        {
+            int n_minus = (signs&1) + ((signs>>1)&1) + ((signs>>2)&1);
+            if (n_minus % 2 != 0)
+                continue;
+
+            Vector e(1,1,1);
+            e[p] = 3;
+            for(int d=0;d<3;d++)
+                if (signs & (1<<d))
+                    e[d] = -e[d];
+            v.push_back(scale*e);
+        }
+
+    return v;
+}
+
+std::vector<Vector> ConvexPolyhedron::RegularTetrahedron()
+{
+    return Tetrahedron::GetBodyVertices();
+}
+
+std::vector<Vector> ConvexPolyhedron::LoadVertices(std::string fname)
+{
+    std::vector<Vector> v;
+    std::ifstream f(fname);
+
+    std::string line;
+    while(std::getline(f, line))
+    {
+        std::istringstream fields(line);
+        double x, y, z;
+        if (fields >> x >> y >> z)
+            v.push_back(Vector(x, y, z));
+    }
+
+    return v;
+}
+
+// ====================== PolyhedronBatch ======================
+
+PolyhedronBatch::PolyhedronBatch(const ConvexPolyhedron &p): p(p)
+{
+    this->size = 0;
+}
+
+bool PolyhedronBatch::Add(uint j, const Vector &offset)
+{
+    this->candidates[this->size] = j;
+    this->offsets[this->size] = offset;
+    this->size++;
+
+    return this->size == PolyhedronBatch::WIDTH;
+}
+
+bool PolyhedronBatch::Flush()
+{
+    bool hit = false;
+    for(int c=0;c<this->size && !hit;c++)
+    {
+        ConvexPolyhedron candidate(this->p.store, this->candidates[c]);
+        hit = this->p.Intersects(&candidate, this->offsets[c]);
+    }
+
+    this->size = 0;
+    return hit;
+}
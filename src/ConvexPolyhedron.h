@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Globals.h"
+#include "Shape.h"
+
+class PolyhedronBatch;
+
+// ========================================================================================================
+// ConvexPolyhedron - Any convex polyhedron given by its vertices (octahedra, cubes, truncated tetrahedra, or
+//                    a vertex file). Like the other shapes, every particle of a run is the same body, so the
+//                    body data is static and set once at startup with SetBody - which recenters the vertices
+//                    on the center of mass and precomputes the hull faces and edge directions, volume, 
+//                    circumradius and inradius.
+//
+// Overlap is decided by GJK on the Minkowski difference of the two vertex sets: the support point in any
+// direction is the vertex with the largest projection, read straight from the ParticleStore vertex cache.
+// ========================================================================================================
+class ConvexPolyhedron: public Shape
+{
+    public:
+    // Candidate container used by the batched narrow phase in MCDriver::CollisionDetectedWith
+    typedef PolyhedronBatch Batch;
+
+    // Constructor - handle on particle `index` of `store`
+    ConvexPolyhedron(ParticleStore *store, uint index);
+
+    // GJK overlap test against p2 translated by `offset`
+    bool Intersects(ConvexPolyhedron *p2, const Vector &offset);
+    Real GetVolume();
+
+    // Lower bound on the distance to p2 translated by `offset` (<= 0 if they may overlap)
+    Real Clearance(ConvexPolyhedron *p2, const Vector &offset);
+
+    // Distance we can move along the unit vector `d` before touching p2 translated by `offset`
+    Real ContactDistance(ConvexPolyhedron *p2, const Vector &offset, const Vector &d);
+
+    // Set the body shared by every particle (any vertices inside the hull are dropped). Returns false if the
+    // vertices don't span a volume.
+    static bool SetBody(const std::vector<Vector> &vertices);
+
+    static std::vector<Vector> GetBodyVertices();
+    static Real GetCircumradius();
+    // Radius of the largest sphere around the COM inside the body - closer centers always overlap
+    static Real GetInradius();
+
+    // Unit edge length bodies
+    static std::vector<Vector> Octahedron();
+    static std::vector<Vector> Cube();
+    static std::vector<Vector> TruncatedTetrahedron();
+    static std::vector<Vector> RegularTetrahedron();
+
+    // Vertices from a text file, one "x y z" per line. Returns an empty list if the file can't be read.
+    static std::vector<Vector> LoadVertices(std::string fname);
+
+    private:
+    // Body data (see SetBody)
+    static std::vector<Vector> body;
+    static std::vector<Vector> face_normals;
+    static std::vector<Vector> edge_directions;
+    static Real volume, circumradius, inradius;
+};
+
+// Up to WIDTH candidates (particle index + lattice offset) queued for the narrow phase
+class PolyhedronBatch
+{
+    public:
+    static const int WIDTH = 8;
+
+    ConvexPolyhedron p;
+    uint candidates[WIDTH];
+    Vector offsets[WIDTH];
+    int size;
+
+    PolyhedronBatch(const ConvexPolyhedron &p);
+
+    // Queue particle `j` translated by `offset`. Returns true once the batch is full and should be flushed.
+    bool Add(uint j, const Vector &offset);
+
+    // Test all queued candidates and empty the batch. Returns true if any of them overlaps.
+    bool Flush();
+};
@@ -1,13 +1,117 @@
 
 #include "Globals.h"
 
-Real u(Real lower, Real upper)
+RNG global_rng;
+
+RNG::RNG(uint64_t seed, unsigned int stream)
+{
+    this->Seed(seed, stream);
+}
+
+// Expand the seed into the 256 bit state with splitmix64, then jump ahead to the requested stream
+void RNG::Seed(uint64_t seed, unsigned int stream)
+{
+    for(int i=0;i<4;i++)
+    {
+        uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        this->state[i] = z ^ (z >> 31);
+    }
+
+    for(unsigned int i=0;i<stream;i++)
+        this->Jump();
+}
+
+static inline uint64_t rotl(const uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+uint64_t RNG::Next()
+{
+    uint64_t *s = this->state;
+    const uint64_t result = rotl(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return result;
+}
+
+// Equivalent to 2^128 calls to Next()
+void RNG::Jump()
+{
+    static const uint64_t JUMP[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+
+    uint64_t s[4] = {0, 0, 0, 0};
+    for(int i=0;i<4;i++)
+        for(int b=0;b<64;b++)
+        {
+            if (JUMP[i] & (1ULL << b))
+                for(int j=0;j<4;j++)
+                    s[j] ^= this->state[j];
+            this->Next();
+        }
+
+    for(int j=0;j<4;j++)
+        this->state[j] = s[j];
+}
+
+Real RNG::u(Real lower, Real upper)
 {
-    // Uniform random number on (0, 1)
-    Real ret = (rand() % 10000) / 10000.0;
+    // Uniform random number on [0, 1) - keep the top 24 bits so the float conversion is exact
+    Real ret = (this->Next() >> 40) * (1.0f / 16777216.0f);
     ret *= upper - lower;
     ret += lower;
 
     return ret;
 }
 
+void RNG::Fill(Real *out, int n, Real lower, Real upper)
+{
+    const Real scale = (upper - lower) * (1.0f / 16777216.0f);
+    for(int i=0;i<n;i++)
+        out[i] = lower + (this->Next() >> 40) * scale;
+}
+
+int RNG::Index(int n)
+{
+    // Multiply-shift maps the top 32 bits onto [0, n) without a division
+    return ((this->Next() >> 32) * (uint64_t)n) >> 32;
+}
+
+uint64_t RNG::Bits()
+{
+    return this->Next();
+}
+
+Quaternion RNG::Orientation()
+{
+    double u1 = this->u(0, 1);
+    double u2 = this->u(0, 2*PI);
+    double u3 = this->u(0, 2*PI);
+
+    // Quaternion(w, x, y, z)
+    return Quaternion(sqrt(u1)*cos(u3), sqrt(1-u1)*sin(u2), sqrt(1-u1)*cos(u2), sqrt(u1)*sin(u3));
+}
+
+void RNG::Save(std::ostream &out)
+{
+    out.write(reinterpret_cast<const char*>(this->state), sizeof(this->state));
+}
+
+void RNG::Load(std::istream &in)
+{
+    in.read(reinterpret_cast<char*>(this->state), sizeof(this->state));
+}
+
+Real u(Real lower, Real upper)
+{
+    return global_rng.u(lower, upper);
+}
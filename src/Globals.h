@@ -4,13 +4,48 @@
 
 #include <Eigen/Dense>
 #include <iostream>
+#include <stdint.h>
 #include <stdio.h>
 
 typedef Eigen::Matrix3d Matrix;
 typedef Eigen::Vector3d Vector;
+typedef Eigen::Quaterniond Quaternion;
 
 typedef float Real;
 
-// Simple uniform RNG - real MC would require a better RNG, but this is fine for our purposes. 
-Real u(Real lower, Real upper);
+// Uniform RNG with its own state (xoshiro256**). Each MCDriver owns one, so replicas can be advanced on separate
+// threads without sharing a generator and a run is reproducible for a fixed seed regardless of the thread count.
+class RNG
+{
+    private:
+    uint64_t state[4];
+
+    uint64_t Next();
+    void Jump();
+
+    public:
+    // `stream` selects a non-overlapping subsequence (2^128 draws apart) for generators that share a seed
+    RNG(uint64_t seed=0, unsigned int stream=0);
+    void Seed(uint64_t seed, unsigned int stream=0);
+
+    // Uniform random number on [lower, upper) with the full 24 bits of float resolution
+    Real u(Real lower, Real upper);
+    // Fill `out` with n uniform random numbers on [lower, upper)
+    void Fill(Real *out, int n, Real lower, Real upper);
+    // Uniform random integer on [0, n)
+    int Index(int n);
+    // Uniformly distributed orientation (unit quaternion, Shoemake's method)
+    Quaternion Orientation();
+    // 64 raw random bits (e.g. to seed other generators)
+    uint64_t Bits();
 
+    // Checkpointing: the full generator state, so a restarted run draws the same numbers
+    void Save(std::ostream &out);
+    void Load(std::istream &in);
+};
+
+// Generator behind the free function u() - only to be used from the main thread
+extern RNG global_rng;
+
+// Uniform random number on [lower, upper) drawn from global_rng
+Real u(Real lower, Real upper);
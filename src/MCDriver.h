@@ -1,9 +1,16 @@
 #pragma once
 
+#include <limits>
 #include "Globals.h"
 #include "Cell.h"
+#include "CellList.h"
 #include "Shape.h"
+#include "Sphere.h"
 #include "Moves.h"
+#include "Checkpoint.h"
+#include "OutputWriter.h"
+#include "Stats.h"
+#include "ThreadPool.h"
 
 template <class ShapeType>
 class MCDriver
@@ -12,9 +19,25 @@ class MCDriver
 
     // ====================== Instance Variables ======================
 
-    // The main instance variables: fundamental cell and particle list
+    // The main instance variables: fundamental cell and particle state (ShapeType handles are built on demand)
     Cell cell;
-    std::vector<ShapeType*> particles;
+    ParticleStore particles;
+
+    // Spatial index over the (wrapped) fractional particle coordinates used for the collision broad phase
+    CellList cell_list;
+
+    // Cell move shortcut: when clearance[i] was computed, it bounded from below the distance from particle i to every 
+    // particle or image whose center was within clearance_reach[i] of its own (-1 = unknown). `drift` accumulates 
+    // the vertex displacement of every accepted particle move since, so a particle move only costs an addition here 
+    // (see GetClearance). A strain that can't close the remaining gap doesn't need a narrow phase for particle i.
+    std::vector<Real> clearance;
+    std::vector<Real> clearance_reach;
+    std::vector<double> clearance_drift;
+    double drift;
+
+    // Particles that needed a narrow phase in the last cell move, and the one that caused the last rejection
+    std::vector<uint> cell_move_checked;
+    int last_blocker;
 
     // List of Moves we'll use (separated for convenience since we do cell moves with a different frequency)
     std::vector<ParticleMove*> particle_moves;
@@ -23,100 +46,137 @@ class MCDriver
     // Thermodynamic pressure
     Real BetaP;
 
-    // We restrict the minimum internal angles by projecting each basis (unit) vector on the others. 
-    // If u_i (dot) u_j > Project_Threshold for any pair i!=j after a cell move, we reject it 
-    Real Project_Threshold;
+    // Rejection-free alternative to the particle moves (see MakeEventChain)
+    EventChain *event_chain;
 
     // Move parameters
     Real p_cell_move; // Probability of choosing a cell move vs single particle move
+    Real p_event_chain; // Probability that a particle move is an event chain instead of a Metropolis move
+
+    // Private random number stream for this driver (and its moves) so drivers can run concurrently
+    RNG rng;
+
+    // Hot path counters/timers (only collected in MC_STATS builds)
+    MCStats stats;
+
+    // Worker threads that run the particle moves of this one driver in parallel (see MakeMoves) - NULL for the 
+    // plain serial MakeMove loop. Not owned by the driver.
+    ThreadPool *pool;
+
+    // Checkerboard of the current sweep: domains along each direction, the (random) bin offset of the domain grid 
+    // and the particles in each domain
+    int n_domains[3], domain_offset[3];
+    std::vector< std::vector<uint> > domain_members;
 
     // ====================== Instance Methods ======================
 
     // Constructor/Destructor
-    MCDriver(int n_particles, Real p_cell_move = 0.1, Real dr_particle=0.1, Real dtheta_particle=0.2, Real dcell = 0.1);
+    MCDriver(int n_particles, RNG rng, Real p_cell_move = 0.1, Real dr_particle=0.1, Real dtheta_particle=0.2, Real dcell = 0.1);
     ~MCDriver();
 
     // Instance methods
-    bool CollisionDetectedWith(ShapeType *t);
-    void UpdatePeriodicImages(ShapeType *shape);
-    void InitializePeriodicImages(ShapeType *shape);
+    ShapeType GetParticle(uint i);
+    bool CollisionDetectedWith(uint i, const Vector &s, MCStats &stats, int trial=-1);
+    bool CollisionDetectedInNeighborBins(uint i, const Vector &s, MCStats &stats, int trial=-1);
+    bool CollisionDetectedAfterStrain(Real strain);
+    Real GetClearance(uint i, Real &reach);
+    void UpdateClearance(uint i, const Vector &s);
+    void UpdateClearanceAfterStrain(Real strain);
     Real GetPackingFraction();
     bool MakeMove();
+    bool MakeCellMove();
+    bool MakeParticleMove(int move_index, RNG &rng, MCStats &stats, double &drift, int domain=-1);
+    bool MakeEventChain();
+
+    // `n_moves` MC steps. Without a pool this is just MakeMove n_moves times; with one, the particle moves run in
+    // checkerboard sweeps (MakeSweep) and the cell moves and event chains in between them.
+    void MakeMoves(int n_moves);
+    bool SetCheckerboard();
+    void MakeSweep(int n_moves);
+    int GetDomain(const Vector &s);
 
     // Setters to modify the maximum move size for cell shape/particle moves
     void SetCellShapeDelta(Real delta);
     void SetParticleTranslationDelta(Real delta);
+    void SetEventChainLength(Real length);
 
     std::string ToString();
 
+    // Checkpointing: everything that decides how this driver continues (the particle count and shape must match)
+    void Save(std::ostream &out);
+    void Load(std::istream &in);
+
     // Simple controller to change the max move sizes to achieve a target acceptance rate.
     // Anecdotally, this doesn't seem to help too much.
     void UpdateMoveSizes(Real TargetAcceptance=0.3);
 };
 
 template <class ShapeType>
-MCDriver<ShapeType>::MCDriver(int n_particles, Real p_cell_move,
+MCDriver<ShapeType>::MCDriver(int n_particles, RNG rng, Real p_cell_move,
                               Real dr, Real dtheta_particle,  // Particle Move Parameters
-                              Real dtheta_cell): cell(n_particles)
+                              Real dtheta_cell): cell(n_particles), particles(ShapeType::GetBodyVertices()), cell_list(2*ShapeType::GetCircumradius(), 2*n_particles), rng(rng)
 {
     this->p_cell_move = p_cell_move;
+    this->p_event_chain = 0;
+    this->pool = NULL;
+    this->cell.SetParticles(&this->particles);
+    this->cell_list.SetCell(this->cell.GetFaceHeights());
+
+    // Nothing is known about the clearances until the first cell move checks every particle
+    this->clearance.assign(n_particles, -1);
+    this->clearance_reach.assign(n_particles, 0);
+    this->clearance_drift.assign(n_particles, 0);
+    this->drift = 0;
+    this->last_blocker = -1;
 
     // Populate the cell moves
-    this->cell_moves.push_back(new CellShapeMove(&this->cell, dtheta_cell));
+    this->cell_moves.push_back(new CellShapeMove(&this->cell, dtheta_cell, &this->rng));
+    this->event_chain = new EventChain(1, &this->rng);
 
     // Initialize the particles in valid (non-overlapping) positions
     for(int i=0;i<n_particles;i++)
     {
         // Random starting orientation
-        Real roll = (rand() % 1000) / 1000.0 * 2*PI;
-        Real pitch = (rand() % 1000) / 1000.0 * 2*PI;
-        Real yaw = (rand() % 1000) / 1000.0 * 2*PI;
+        Quaternion q = this->rng.Orientation();
         
         // Initialize particle at a random location, then try translation moves until a non-colliding position is found
-        Vector v(.5*n_particles*u(0, .1), .5*n_particles*u(0, .1), .5*n_particles*u(0, .1));
+        Vector v(.5*n_particles*this->rng.u(0, .1), .5*n_particles*this->rng.u(0, .1), .5*n_particles*this->rng.u(0, .1));
 
-        // Create the particle and push it to the driver's particle list
-        ShapeType *t = new ShapeType(v);
-        t->Rotate(roll, pitch, yaw);
-        this->particles.push_back(t);
+        // Create the particle in the driver's particle store
+        this->particles.Add(v, q);
 
         // Add a translation move for this particle
-        this->particle_moves.push_back(new ParticleTranslation(t, dr));
+        this->particle_moves.push_back(new ParticleTranslation(&this->particles, i, dr));
 
         // Keep applying particle translations until a valid position is found
-        this->InitializePeriodicImages(t);
-        while( this->CollisionDetectedWith(t) )
+        Vector s = this->cell.WrapShape(i);
+        this->cell_list.Insert(s);
+
+        uint trial = this->particles.GetTrial(0);
+        while( this->CollisionDetectedWith(i, s, this->stats) )
         {
-            this->particle_moves.back()->Apply();
-            this->cell.WrapShape(t);
-            this->UpdatePeriodicImages(t);
+            this->particle_moves.back()->Propose(trial, this->rng);
+            this->particle_moves.back()->Commit(trial);
+            s = this->cell.WrapShape(i);
+            this->cell_list.Update(i, s);
         }
-           
-        // Now that we've settled on a position, wrap it and update the periodic images
-        this->cell.WrapShape(t);
-        this->UpdatePeriodicImages(t);
         
         // Finally, add a rotation move
-        this->particle_moves.push_back(new ParticleRotation(t, dtheta_particle));
+        this->particle_moves.push_back(new ParticleRotation(&this->particles, i, dtheta_particle));
     }
-
-    // Give cell a reference to each particle
-    for(int i=0;i<n_particles;i++)
-        cell.particles.push_back(particles[i]);
 }
 
 // Destructor
 template <class ShapeType>
 MCDriver<ShapeType>::~MCDriver()
 {
-    for(uint i=0;i<this->particles.size();i++)
-        delete this->particles[i];
-
     for(uint i=0;i<this->particle_moves.size();i++)
         delete this->particle_moves[i];
 
     for(uint i=0;i<this->cell_moves.size();i++)
         delete this->cell_moves[i];
+
+    delete this->event_chain;
 }
 
 // Setters for the move parameters
@@ -129,6 +189,12 @@ void MCDriver<ShapeType>::SetParticleTranslationDelta(Real delta)
     }
 }
 
+template <class ShapeType>
+void MCDriver<ShapeType>::SetEventChainLength(Real length)
+{
+    this->event_chain->delta_max = length;
+}
+
 template <class ShapeType>
 void MCDriver<ShapeType>::SetCellShapeDelta(Real delta)
 {
@@ -136,227 +202,590 @@ void MCDriver<ShapeType>::SetCellShapeDelta(Real delta)
         this->cell_moves[0]->delta_max = delta;
 }
 
-// Returns `true` if collisions are detected
+// Handle on particle `i` for the shape-specific geometry (narrow phase, clearance)
+template <class ShapeType>
+ShapeType MCDriver<ShapeType>::GetParticle(uint i)
+{
+    return ShapeType(&this->particles, i);
+}
+
+// Returns `true` if particle `i`, with its center at wrapped fractional coordinates `s`, collides with any other
+// particle or periodic image. Only the particles in the neighboring bins of the cell list are tested, and 
+// periodic images are generated on the fly as lattice offsets h * [j,k,l]. Candidates are queued in a 
+// ShapeType::Batch and handed to the narrow phase WIDTH at a time. If `trial` is a trial slot of the particle 
+// store, the pose in it stands in for particle i (see MakeParticleMove). The broad/narrow phase counters go to
+// `stats`, which is the calling domain's own MCStats during a checkerboard sweep.
 template <class ShapeType>
-bool MCDriver<ShapeType>::CollisionDetectedWith(ShapeType *t)
+bool MCDriver<ShapeType>::CollisionDetectedWith(uint i, const Vector &s, MCStats &stats, int trial)
 {
-    // First, check collisions with other particles
-    for(uint i=0;i<particles.size();i++)
-        if (t->Intersects(particles[i]) && (t->GetCOM() - particles[i]->GetCOM()).norm() > .00001 )
+    return this->CollisionDetectedInNeighborBins(i, s, stats, trial);
+}
+
+// Broad phase over the cell list + batched narrow phase (the general path behind CollisionDetectedWith)
+template <class ShapeType>
+bool MCDriver<ShapeType>::CollisionDetectedInNeighborBins(uint i, const Vector &s, MCStats &stats, int trial)
+{
+    uint tested = (trial < 0) ? i : trial;
+    typename ShapeType::Batch batch(this->GetParticle(tested));
+
+    // Everything still queued at a flush made it past the bounding sphere test
+    auto flush = [&]() -> bool
+    {
+        STATS_COUNT(stats, NARROW_CALLS, batch.size);
+        return batch.Flush();
+    };
+
+    // Our own periodic images move along with us, so they are tested at the trial pose (the cell list still has the 
+    // old one, whose image shifts don't apply to the trial once it has wrapped into another bin)
+    bool hit = this->cell_list.ForEachSelfImage([&](const int shift[3]) -> bool
+    {
+        STATS_COUNT(stats, BROAD_CANDIDATES, 1);
+        return batch.Add(tested, this->cell.h * Vector(shift[0], shift[1], shift[2])) && flush();
+    });
+
+    hit = hit || this->cell_list.ForEachNeighbor(s, [&](int j, const int shift[3]) -> bool
+    {
+        if (j == (int)i)
+            return false;
+
+        STATS_COUNT(stats, BROAD_CANDIDATES, 1);
+
+        bool central = (shift[0] == 0 && shift[1] == 0 && shift[2] == 0);
+        Vector offset(0,0,0);
+        if (!central)
+            offset = this->cell.h * Vector(shift[0], shift[1], shift[2]);
+
+        // Test as soon as the batch fills up so we can still bail out early
+        return batch.Add(j, offset) && flush();
+    });
+
+    return hit || flush();
+}
+
+// ========================================================================================================
+// CollisionDetectedAfterStrain - Collision check for every particle after a cell move. The particles ride 
+// along with the cell, so a pair separated by r moves apart by at most `strain`*|r| (strain bounds the norm 
+// of h_new h_old^-1 - I). Particles whose cached clearance covers that are skipped; the rest get a narrow 
+// phase, starting with whichever particle blocked the previous cell move.
+// ========================================================================================================
+template <class ShapeType>
+bool MCDriver<ShapeType>::CollisionDetectedAfterStrain(Real strain)
+{
+    this->cell_move_checked.clear();
+    for(uint i=0;i<this->particles.Size();i++)
+    {
+        // Pairs inside the reach keep a gap of at least c - strain*reach, pairs outside it stay beyond 2R
+        Real reach;
+        Real c = this->GetClearance(i, reach);
+        if (!(reach*(1 - strain) > 2*ShapeType::GetCircumradius() && c > strain*reach))
+            this->cell_move_checked.push_back(i);
+    }
+
+    STATS_COUNT(this->stats, CELL_CHECKED, this->cell_move_checked.size());
+    STATS_COUNT(this->stats, CELL_SKIPPED, this->particles.Size() - this->cell_move_checked.size());
+
+    for(uint k=0;k<this->cell_move_checked.size();k++)
+        if ((int)this->cell_move_checked[k] == this->last_blocker)
         {
+            std::swap(this->cell_move_checked[k], this->cell_move_checked[0]);
+            break;
+        }
+
+    for(uint k=0;k<this->cell_move_checked.size();k++)
+    {
+        uint i = this->cell_move_checked[k];
+        if (this->CollisionDetectedWith(i, this->cell_list.coords[i], this->stats))
+        {
+            this->last_blocker = i;
             return true;
         }
+    }
+
+    return false;
+}
+
+// Current clearance of particle `i` and the center distance it covers. Every particle move since it was computed 
+// can have closed a gap, or carried a particle in from outside the reach, by its displacement.
+template <class ShapeType>
+Real MCDriver<ShapeType>::GetClearance(uint i, Real &reach)
+{
+    Real d = this->drift - this->clearance_drift[i];
+    reach = this->clearance_reach[i] - d;
+
+    return this->clearance[i] - d;
+}
 
-    for(uint i=0;i<particles.size();i++)
+// Recompute the clearance of particle `i` (at wrapped fractional coordinates `s`) and tighten the clearance of 
+// every neighbor it sees
+template <class ShapeType>
+void MCDriver<ShapeType>::UpdateClearance(uint i, const Vector &s)
+{
+    ShapeType t = this->GetParticle(i);
+    Vector com = t.GetCOM();
+    Real c = std::numeric_limits<Real>::max();
+
+    // Our own images (see CellList::ForEachSelfImage)
+    this->cell_list.ForEachSelfImage([&](const int shift[3]) -> bool
     {
-        ShapeType *particle = this->particles[i];
+        c = std::min(c, t.Clearance(&t, this->cell.h * Vector(shift[0], shift[1], shift[2])));
+        return false;
+    });
 
-        // Now check collisions with periodic images
-        for(uint j=0;j<particle->periodic_images.size();j++)
-            if (t->Intersects(particle->periodic_images[j]))
-                return true;
+    this->cell_list.ForEachNeighbor(s, [&](int j, const int shift[3]) -> bool
+    {
+        if (j == (int)i)
+            return false;
+
+        bool central = (shift[0] == 0 && shift[1] == 0 && shift[2] == 0);
+        Vector offset(0,0,0);
+        if (!central)
+            offset = this->cell.h * Vector(shift[0], shift[1], shift[2]);
+
+        // The bounding spheres already give a lower bound - only refine it when it could lower either clearance
+        Real reach_j;
+        Real c_j = this->GetClearance(j, reach_j);
+        Real bound = (this->particles.GetCOM(j) + offset - com).norm() - 2*ShapeType::GetCircumradius();
+        if (bound >= c && bound >= c_j)
+            return false;
+
+        ShapeType t_j = this->GetParticle(j);
+        Real gap = t.Clearance(&t_j, offset);
+        c = std::min(c, gap);
+        if (gap < c_j)
+            this->clearance[j] -= c_j - gap;
+
+        return false;
+    });
+
+    this->clearance[i] = c;
+    this->clearance_reach[i] = this->cell_list.GetReach(this->cell.GetFaceHeights());
+    this->clearance_drift[i] = this->drift;
+}
+
+// Bring the clearances up to date after an accepted cell move with the given strain bound
+template <class ShapeType>
+void MCDriver<ShapeType>::UpdateClearanceAfterStrain(Real strain)
+{
+    // Gaps shrink by at most strain*reach and the reach contracts with the cell...
+    for(uint i=0;i<this->particles.Size();i++)
+    {
+        Real reach;
+        this->GetClearance(i, reach);
+        if (reach > 0)
+        {
+            this->clearance[i] -= strain*reach;
+            this->clearance_reach[i] -= strain*reach;
+        }
     }
 
-    return false;
+    // ...while the particles we had to check anyway get a fresh clearance under the new cell
+    for(uint k=0;k<this->cell_move_checked.size();k++)
+    {
+        uint i = this->cell_move_checked[k];
+        this->UpdateClearance(i, this->cell_list.coords[i]);
+    }
 }
 
 template <class ShapeType>
 bool MCDriver<ShapeType>::MakeMove()
+{
+    // First, choose the move to make
+    if (this->rng.u(0, 1) < this->p_cell_move)
+        return this->MakeCellMove();
+    else if (this->p_event_chain > 0 && this->rng.u(0, 1) < this->p_event_chain)
+        return this->MakeEventChain();
+    else
+        return this->MakeParticleMove(this->rng.Index(this->particle_moves.size()), this->rng, this->stats, this->drift);
+}
+
+// Cell shape/volume move: collision checks for every particle (short-cut by the clearances)
+template <class ShapeType>
+bool MCDriver<ShapeType>::MakeCellMove()
 {
     // Assume the move is good until proven otherwise
     bool accepted = true;
 
-    Move *AttemptedMove;
-        
-    // First, choose the move to make
-    if (u(0, 1) < this->p_cell_move)
-    {
-        // Make a CellMove (shape or volume change)
-        int move_index = u(0,1) * this->cell_moves.size();
-        CellMove *move = this->cell_moves[move_index];
-        AttemptedMove = move;
+    // Make a CellMove (shape or volume change)
+    int move_index = this->rng.Index(this->cell_moves.size());
+    CellMove *move = this->cell_moves[move_index];
 
-        // Apply the move and record the change in cell volume
-        Real V_Before = this->cell.GetVolume();
+    STATS_COUNT(this->stats, CELL_MOVES, 1);
+
+    // Apply the move and record the change in cell volume
+    Real V_Before = this->cell.GetVolume();
+    {
+        STATS_TIMER(this->stats, CELL_APPLY);
         move->Apply();
-        Real V_After = this->cell.GetVolume();
+    }
+    Real V_After = this->cell.GetVolume();
+
+    // Enforce a minimum cell vector length
+    for(int i=0;i<3;i++)
+        if (this->cell.h.col(i).norm() < .5)
+            accepted = false;
     
-        // Enforce a minimum cell vector length
-        for(int i=0;i<3;i++)
-            if (this->cell.h.col(i).norm() < .5)
-                accepted = false;
-        
-        // ---------------------------------------------------------------------------------------------------------------------------------------------
-        // In rare cases, the MC trajectory can diverge after shearing the cell into a state where collisions occur beyond the first periodic shell (and 
-        // are therefore missed by the collision detection). A simple solution is to limit the allowed internal angles between basis vectors
-        // ---------------------------------------------------------------------------------------------------------------------------------------------
-
-        // Check the interior angles
-        Vector e0(this->cell.h.col(0)); e0 /= e0.norm();
-        Vector e1(this->cell.h.col(1)); e1 /= e1.norm();
-        Vector e2(this->cell.h.col(2)); e2 /= e2.norm();
-
-        Real overlap_0 = std::abs(e0.dot(e1));
-        Real overlap_1 = std::abs(e0.dot(e2));
-        Real overlap_2 = std::abs(e1.dot(e2));
+    // The cell list visits every periodic image the face heights call for, so the collision checks are exact for any
+    // cell shape - up to CellList::MAX_SHELLS image shells, which only a cell thinner than the particles could need
+    if (!this->cell_list.Covers(this->cell.GetFaceHeights()))
+        accepted = false;
+
+    // The Boltzmann factor for the change in volume at the applied pressure doesn't depend on the configuration,
+    // so test it before paying for any collision detection
+    if(accepted && !(this->rng.u(0,1) < exp(-this->BetaP*(V_After-V_Before))))
+        accepted = false;
+
+    // If we haven't ruled it out yet, check for collisions after the volume change
+    Real strain = 0;
+    if(!accepted)
+        STATS_COUNT(this->stats, CELL_MOVES_PRESCREENED, 1);
+    else
+    {
+        STATS_TIMER(this->stats, CELL_COLLISION);
+
+        // The fractional coordinates move with the cell, but the bins may have become too narrow (or can be refined)
+        this->cell_list.SetCell(this->cell.GetFaceHeights());
+
+        // Bound on how far any pair separation r can move: |(h_new h_old^-1 - I) r| <= strain*|r|
+        strain = (this->cell.h * move->h_old_inv - Matrix::Identity()).norm();
+
+        accepted = !this->CollisionDetectedAfterStrain(strain);
+    }
     
-        // The last case is a flat parallelpiped (strongly sheared)
-        // Avoid this by checking the overlap of the unit normal of each plane and the last basis vector
-        Vector u_plane;
-        u_plane = e0.cross(e1); u_plane /= u_plane.norm(); if(std::abs(e2.dot(u_plane)) < 1-Project_Threshold) accepted = false;
-        u_plane = e0.cross(e2); u_plane /= u_plane.norm(); if(std::abs(e1.dot(u_plane)) < 1-Project_Threshold) accepted = false;
-        u_plane = e1.cross(e2); u_plane /= u_plane.norm(); if(std::abs(e0.dot(u_plane)) < 1-Project_Threshold) accepted = false;
-
-        if( 
-            (overlap_0 > Project_Threshold) || 
-            (overlap_1 > Project_Threshold) || 
-            (overlap_2 > Project_Threshold)
-          )
-        {
-            accepted = false;
-        }
+    // If accepted is still true, then no collisions happened and the move is accepted
+    if(accepted)
+    {
+        STATS_COUNT(this->stats, CELL_MOVES_ACCEPTED, 1);
+        STATS_TIMER(this->stats, CELL_UPDATE);
 
-        // If we haven't ruled it out based on interior angles, check for collisions after the volume change
-        if(accepted)
+        // The particles are stored in fractional coordinates, so they already followed the cell and nothing per 
+        // particle is left to do - unless the basis gets reduced (to keep a sheared cell from thinning out the 
+        // bins): it's the same lattice, but the fractional coordinates change, and the bins with the face heights
+        if (this->cell.Reduce())
         {
-            // Have to update the images before collision detection 
-            for(uint i=0;i<this->particles.size();i++)
-                this->UpdatePeriodicImages(this->particles[i]);
+            this->cell_list.SetCell(this->cell.GetFaceHeights());
+            for(uint i=0;i<this->particles.Size();i++)          
+                this->cell_list.Update(i, this->particles.GetFractional(i));
+        }
 
-            for(uint i=0;i<this->particles.size();i++)
-            {
-                // Check for collisions 
-                accepted = !(this->CollisionDetectedWith(this->particles[i]));
+        this->UpdateClearanceAfterStrain(strain);
+    }
 
-                if(!accepted)
-                    break;
-            }
-        }
-        
-        // If accepted is still true, then no collisions happened. In this case, accept on the Boltzmann factor for a change in volume
-        // given the applied pressure
-        if(accepted)
-        {
-            if (u(0,1) < exp(-this->BetaP*(V_After-V_Before)))
-            {
-                accepted = true;
+    // If the move wasn't accepted, we need to revert the cell 
+    if(!accepted)
+    {
+        move->Undo();
+        this->cell_list.SetCell(this->cell.GetFaceHeights());
+    }
 
-                for(uint i=0;i<this->particles.size();i++)          
-                    this->cell.WrapShape(this->particles[i]);
-            }
-            else
-                accepted = false;
+    return accepted;
+}
 
-        }
+// Metropolis translation or rotation `move_index` (particle_moves[2i] / [2i+1] belong to particle i). The counters 
+// and the displacement go to `stats` and `drift`, which are the driver's own except during a checkerboard sweep.
+template <class ShapeType>
+bool MCDriver<ShapeType>::MakeParticleMove(int move_index, RNG &rng, MCStats &stats, double &drift, int domain)
+{
+    bool accepted;
+    ParticleMove *move = this->particle_moves[move_index];
+
+    // Each particle owns a (translation, rotation) pair of moves - see the constructor
+    uint i = move_index / 2;
+    bool translation = (move_index % 2 == 0);
+    if (translation)
+        STATS_COUNT(stats, TRANSLATIONS, 1);
+    else
+        STATS_COUNT(stats, ROTATIONS, 1);
+
+    // The move proposes a trial pose in a trial slot of the store (one per domain in a checkerboard sweep), and the 
+    // particle itself is only written if it is accepted. Wrap the trial position so the broad phase can locate it in
+    // the cell list (measuring the displacement first, since wrapping adds a lattice translation).
+    uint trial = this->particles.GetTrial(std::max(domain, 0));
+    Real displacement;
+    Vector s_new;
+    {
+        STATS_TIMER(stats, PARTICLE_APPLY);
+        move->Propose(trial, rng);
+        displacement = move->GetDisplacement(trial);
+    }
+    {
+        STATS_TIMER(stats, WRAP);
+        s_new = this->cell.WrapShape(trial);
+    }
 
-        // If the move wasn't accepted, we need to revert the cell 
-        if(!accepted)
-        {
-            AttemptedMove->Undo();
-            for(uint i=0;i<this->particles.size();i++)
-                this->UpdatePeriodicImages(this->particles[i]);
-        }
+    // In a checkerboard sweep the particle can't leave its domain (see MakeSweep)
+    if (domain >= 0 && this->GetDomain(s_new) != domain)
+    {
+        STATS_COUNT(stats, DOMAIN_REJECTIONS, 1);
+        accepted = false;
     }
     else
     {
-        // randomly select a particle move
-        int move_index = rand() % this->particle_moves.size();
-        ParticleMove *move = this->particle_moves[move_index];
-        AttemptedMove = move;
+        // Check for collisions - CollisionDetectedWith returns true if collisions are detected
+        STATS_TIMER(stats, COLLISION);
+        accepted = !(this->CollisionDetectedWith(i, s_new, stats, trial));
+    }
 
-        ShapeType *t = reinterpret_cast<ShapeType*>(move->particle);
+    if(accepted)
+    {
+        if (translation)
+            STATS_COUNT(stats, TRANSLATIONS_ACCEPTED, 1);
+        else
+            STATS_COUNT(stats, ROTATIONS_ACCEPTED, 1);
 
-        Vector s_old = this->cell.PartialCoords(t->GetCOM());
-        move->Apply();
-        Vector s_new = this->cell.PartialCoords(t->GetCOM());
+        move->Commit(trial);
+        this->cell_list.Update(i, s_new);
+        drift += displacement;
+    }
 
-        // Check for collisions - CollisionDetectedWith returns true if collisions are detected
-        accepted = !(this->CollisionDetectedWith(t));
-    
-        if(accepted)
+    return accepted;
+}
+
+// ========================================================================================================
+// MakeMoves - Parallel particle moves for one large system: the bins of the cell list are grouped into 
+// domains along every direction with at least 4 bins (one or two bins each, an even number of them), and 
+// the domains are colored by the parity of their index in each direction, a 2x2x2 checkerboard. Two domains of 
+// one color are separated by a whole domain, i.e. at least one bin, so nothing a particle move in one of them 
+// reads or writes is touched by the others. The colors take turns; the domains of the active one run their 
+// particle moves concurrently and reject every move that would leave the domain. The domain grid is shifted by 
+// a random number of bins every sweep so no boundary stays put. Cell moves and event chains touch every 
+// particle, so they run serially between the sweeps.
+//
+// The particles of each domain draw from their own generator, seeded from the driver's, so the trajectory 
+// doesn't depend on the number of threads.
+// ========================================================================================================
+template <class ShapeType>
+void MCDriver<ShapeType>::MakeMoves(int n_moves)
+{
+    if (!this->pool || !this->SetCheckerboard())
+    {
+        for(int k=0;k<n_moves;k++)
+            this->MakeMove();
+        return;
+    }
+
+    // Draw the kind of every step as MakeMove would: true for a cell move, false for an event chain
+    std::vector<bool> serial;
+    int n_particle_moves = 0;
+    for(int k=0;k<n_moves;k++)
+    {
+        if (this->rng.u(0, 1) < this->p_cell_move)
+            serial.push_back(true);
+        else if (this->p_event_chain > 0 && this->rng.u(0, 1) < this->p_event_chain)
+            serial.push_back(false);
+        else
+            n_particle_moves++;
+    }
+
+    // Sweeps of at most one move per particle, with the serial moves spread evenly between them
+    int n = this->particles.Size();
+    int n_sweeps = std::max(1, (n_particle_moves + n - 1) / n);
+    int n_serial = serial.size();
+    for(int k=0;k<n_sweeps;k++)
+    {
+        int moves = (int64_t)n_particle_moves*(k + 1)/n_sweeps - (int64_t)n_particle_moves*k/n_sweeps;
+        if (moves > 0 && this->SetCheckerboard())
+            this->MakeSweep(moves);
+        else
+            for(int m=0;m<moves;m++)
+                this->MakeParticleMove(this->rng.Index(this->particle_moves.size()), this->rng, this->stats, this->drift);
+
+        for(int m=n_serial*k/n_sweeps;m<n_serial*(k + 1)/n_sweeps;m++)
         {
-            this->cell.WrapShape(t);
-            this->UpdatePeriodicImages(t);
+            if (serial[m])
+                this->MakeCellMove();
+            else
+                this->MakeEventChain();
         }
+    }
+}
 
-        if(!accepted)
-            AttemptedMove->Undo();
+// Lay out the domains for the current bins. Returns false if no color would get more than one domain.
+template <class ShapeType>
+bool MCDriver<ShapeType>::SetCheckerboard()
+{
+    int per_color = 1;
+    for(int d=0;d<3;d++)
+    {
+        int n = this->cell_list.n_bins[d];
+        this->n_domains[d] = (n >= 4) ? n - n % 2 : 1;
+        this->domain_offset[d] = 0;
+        per_color *= (this->n_domains[d] > 1) ? this->n_domains[d] / 2 : 1;
     }
 
-    return accepted;
+    return per_color > 1;
 }
 
+// Domain of the bin that wrapped fractional coordinates `s` fall into
 template <class ShapeType>
-Real MCDriver<ShapeType>::GetPackingFraction()
+int MCDriver<ShapeType>::GetDomain(const Vector &s)
 {
-    return this->particles.size() * this->particles[0]->GetVolume() / this->cell.GetVolume();
+    int b = this->cell_list.GetBin(s);
+    int bin[3] = {b / (this->cell_list.n_bins[1]*this->cell_list.n_bins[2]), (b / this->cell_list.n_bins[2]) % this->cell_list.n_bins[1], b % this->cell_list.n_bins[2]};
+
+    int domain = 0;
+    for(int d=0;d<3;d++)
+    {
+        int n = this->cell_list.n_bins[d];
+        domain = domain*this->n_domains[d] + ((bin[d] + this->domain_offset[d]) % n)*this->n_domains[d]/n;
+    }
+
+    return domain;
 }
 
-// Update periodic images
+// One checkerboard sweep of `n_moves` particle moves (SetCheckerboard has to have succeeded)
 template <class ShapeType>
-void MCDriver<ShapeType>::UpdatePeriodicImages(ShapeType *t)
+void MCDriver<ShapeType>::MakeSweep(int n_moves)
 {
-    int ghost_idx = 0;
-
-    // [j, k, l] defines a periodic image to check - we only check the first shell, which is *not* rigorous
-    // but we also restrict the minimum internal cell angles to avoid risking second-shell collisions.
-    for(int j=-1;j<2;j++)
-    for(int k=-1;k<2;k++)
-    for(int l=-1;l<2;l++)
+    for(int d=0;d<3;d++)
+        this->domain_offset[d] = this->rng.Index(this->cell_list.n_bins[d]);
+
+    // A particle never leaves its domain during the sweep, so the members stay valid for every color
+    int n_total = this->n_domains[0]*this->n_domains[1]*this->n_domains[2];
+    this->domain_members.resize(n_total);
+    for(int D=0;D<n_total;D++)
+        this->domain_members[D].clear();
+
+    // Every domain proposes its moves in its own trial slot
+    this->particles.ReserveTrials(n_total);
+    for(uint i=0;i<this->particles.Size();i++)
+        this->domain_members[this->GetDomain(this->cell_list.coords[i])].push_back(i);
+
+    // The colors in random order
+    int colors[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    for(int c=7;c>0;c--)
+        std::swap(colors[c], colors[this->rng.Index(c + 1)]);
+
+    for(int c=0;c<8;c++)
     {
-        if(!(j==0&&k==0&&l==0))
+        std::vector<int> active;
+        for(int D=0;D<n_total;D++)
         {
-            Vector index(j,k,l);
+            int index[3] = {D / (this->n_domains[1]*this->n_domains[2]), (D / this->n_domains[2]) % this->n_domains[1], D % this->n_domains[2]};
+            int color = (index[0] & 1) | (index[1] & 1) << 1 | (index[2] & 1) << 2;
+            if (color == colors[c] && !this->domain_members[D].empty())
+                active.push_back(D);
+        }
+
+        if (active.empty())
+            continue;
+
+        uint64_t seed = this->rng.Bits();
+        std::vector<MCStats> domain_stats(active.size());
+        std::vector<double> domain_drift(active.size(), 0);
+
+        this->pool->Run([&](int t)
+        {
+            int D = active[t];
+            RNG rng(seed + D);
+            const std::vector<uint> &members = this->domain_members[D];
+
+            // Every domain gets its share of the sweep by particle count (the fraction is rounded at random)
+            double share = double(n_moves)*members.size()/this->particles.Size();
+            int k = int(share);
+            if (rng.u(0, 1) < share - k)
+                k++;
 
-            ShapeType *ghost = reinterpret_cast<ShapeType*>(t->periodic_images[ghost_idx++]);
-            // Copy the particle
-            for(uint i=0;i<t->vertices.size();i++)
-                ghost->vertices[i] = t->vertices[i];
+            for(int m=0;m<k;m++)
+            {
+                int move_index = 2*members[rng.Index(members.size())] + rng.Index(2);
+                this->MakeParticleMove(move_index, rng, domain_stats[t], domain_drift[t], D);
+            }
+        }, active.size());
 
-            // Translate the ghost to its image position
-            ghost->Translate(this->cell.h * index);
+        for(uint t=0;t<active.size();t++)
+        {
+            this->stats.Merge(domain_stats[t]);
+            this->drift += domain_drift[t];
         }
     }
 }
 
-// Generate all periodic images of the particles in the cell
+// ========================================================================================================
+// MakeEventChain - Pick a particle and a direction d, then repeatedly find the first contact of the moving 
+// particle along d: move it (up to EventChain::GAP short of) there and hand the rest of the chain to the particle 
+// it hit. Contacts are searched one step at a time around the middle of the step: every particle a step of 
+// length L could reach has its center within 2R + L/2 of the midpoint, so L = 2(reach - 2R) keeps all of them 
+// inside the cell list neighborhood. A chain never overlaps anything, so it is always accepted.
+// ========================================================================================================
 template <class ShapeType>
-void MCDriver<ShapeType>::InitializePeriodicImages(ShapeType* t)
+bool MCDriver<ShapeType>::MakeEventChain()
 {
-    // Clear the current list of images if it's already populated
-    for(uint i=0;i<t->periodic_images.size();i++)
-        delete t->periodic_images[i];
-    t->periodic_images.clear();
-
-    for(int j=-1;j<2;j++)
-    for(int k=-1;k<2;k++)
-    for(int l=-1;l<2;l++)
+    STATS_TIMER(this->stats, EVENT_CHAIN);
+    STATS_COUNT(this->stats, EVENT_CHAINS, 1);
+
+    this->event_chain->Apply();
+    const Vector d = this->event_chain->direction;
+
+    uint i = this->rng.Index(this->particles.Size());
+    Real remaining = this->event_chain->delta_max;
+    Real R2 = 2*ShapeType::GetCircumradius();
+    Real step_max = 2*(this->cell_list.GetReach(this->cell.GetFaceHeights()) - R2);
+
+    for(int step=0;step<EventChain::MAX_STEPS && remaining > 0 && step_max > 0;step++)
     {
-        if(!(j==0&&k==0&&l==0))
+        Real L = std::min(remaining, step_max);
+
+        // Midpoint of the step in wrapped fractional coordinates; image k of the cell holds the unwrapped one, 
+        // so the neighbor images the cell list reports (relative to the wrapped point) are shifted by k for us
+        Vector mid = this->cell_list.coords[i] + this->cell.GetInverse() * (.5*L*d);
+        Vector k(floor(mid[0]), floor(mid[1]), floor(mid[2]));
+        mid = Cell::WrapCoords(mid - k);
+
+        ShapeType t = this->GetParticle(i);
+        Vector com = this->particles.GetCOM(i);
+        Real first = L;
+        int hit = -1;
+
+        this->cell_list.ForEachNeighbor(mid, [&](int j, const int shift[3]) -> bool
+        {
+            // Our own images move along with us
+            if (j == (int)i)
+                return false;
+
+            // Bounding spheres: j has to sit within 2R of the part of the ray that is still ahead of us
+            Vector offset = this->cell.h * (Vector(shift[0], shift[1], shift[2]) + k);
+            Vector r = this->particles.GetCOM(j) + offset - com;
+            Real along = r.dot(d);
+            if (along < -R2 || along > first + R2 || r.squaredNorm() - along*along > R2*R2)
+                return false;
+
+            ShapeType t_j = this->GetParticle(j);
+            Real c = t.ContactDistance(&t_j, offset, d);
+            if (c < first)
+            {
+                first = c;
+                hit = j;
+            }
+
+            return false;
+        });
+
+        Real moved = (hit < 0) ? L : std::max((Real)0, first - EventChain::GAP);
+        this->particles.Translate(i, moved*d);
+        this->cell_list.Update(i, this->cell.WrapShape(i));
+        this->drift += moved;
+
+        remaining -= first;
+        if (hit >= 0)
         {
-            t->periodic_images.push_back(new ShapeType(*t));
+            STATS_COUNT(this->stats, CHAIN_CONTACTS, 1);
+            i = hit;
         }
     }
 
-    this->UpdatePeriodicImages(t);
+    return true;
 }
 
 template <class ShapeType>
-std::string MCDriver<ShapeType>::ToString()
+Real MCDriver<ShapeType>::GetPackingFraction()
 {
-    std::string s = "";
-
-    // First, the cell tensor
-    s += this->cell.ToString();
-    s += "\n";
-    
-    // Now the particles
-    for(uint i=0;i<this->particles.size();i++)
-    {
-        s += this->particles[i]->ToString() + "\n";
-    }
+    return this->particles.Size() * this->GetParticle(0).GetVolume() / this->cell.GetVolume();
+}
 
-    return s;
+template <class ShapeType>
+std::string MCDriver<ShapeType>::ToString()
+{
+    return ConfigurationToString(this->cell, this->particles);
 }
 
 template <class ShapeType>
@@ -376,3 +805,123 @@ void MCDriver<ShapeType>::UpdateMoveSizes(Real TargetAcceptance)
         m->Reset();
     }
 }
+
+// ========================================================================================================
+// Save/Load - Binary snapshot of the driver between MC steps: the cell, the particles and the spatial index 
+// exactly as they are (bins included), the clearance bookkeeping, the move sizes and acceptance counters, the 
+// pressure and the RNG state. Loading into a driver built with the same particle count and shape continues the 
+// trajectory bit for bit.
+// ========================================================================================================
+template <class ShapeType>
+void MCDriver<ShapeType>::Save(std::ostream &out)
+{
+    checkpoint::Write(out, this->BetaP);
+    checkpoint::Write(out, this->p_cell_move);
+    checkpoint::Write(out, this->p_event_chain);
+    this->rng.Save(out);
+
+    this->cell.Save(out);
+    this->particles.Save(out);
+    this->cell_list.Save(out);
+
+    checkpoint::WriteVector(out, this->clearance);
+    checkpoint::WriteVector(out, this->clearance_reach);
+    checkpoint::WriteVector(out, this->clearance_drift);
+    checkpoint::Write(out, this->drift);
+    checkpoint::Write(out, this->last_blocker);
+
+    for(uint i=0;i<this->particle_moves.size();i++)
+        this->particle_moves[i]->Save(out);
+    for(uint i=0;i<this->cell_moves.size();i++)
+        this->cell_moves[i]->Save(out);
+    this->event_chain->Save(out);
+}
+
+template <class ShapeType>
+void MCDriver<ShapeType>::Load(std::istream &in)
+{
+    uint n = this->particles.Size();
+
+    checkpoint::Read(in, this->BetaP);
+    checkpoint::Read(in, this->p_cell_move);
+    checkpoint::Read(in, this->p_event_chain);
+    this->rng.Load(in);
+
+    this->cell.Load(in);
+    this->particles.Load(in);
+    this->cell_list.Load(in);
+    // The image shells aren't stored - they follow from the cell
+    this->cell_list.SetCell(this->cell.GetFaceHeights());
+
+    checkpoint::ReadVector(in, this->clearance);
+    checkpoint::ReadVector(in, this->clearance_reach);
+    checkpoint::ReadVector(in, this->clearance_drift);
+    checkpoint::Read(in, this->drift);
+    checkpoint::Read(in, this->last_blocker);
+
+    for(uint i=0;i<this->particle_moves.size();i++)
+        this->particle_moves[i]->Load(in);
+    for(uint i=0;i<this->cell_moves.size();i++)
+        this->cell_moves[i]->Load(in);
+    this->event_chain->Load(in);
+
+    // The moves hold on to particle indices, so the checkpoint must be for the same number of particles
+    if (this->particles.Size() != n || this->cell_list.coords.size() != n || this->clearance.size() != n)
+        in.setstate(std::ios::failbit);
+}
+
+// ========================================================================================================
+// CollisionDetectedWith (spheres) - Hard spheres only need the center distance. Once every face height is at 
+// least twice the diameter (2+ bins along every direction), a center closer than a diameter is always the 
+// minimum image found by rounding the fractional separation, and no other image can be that close. If the cell 
+// list also has at most 3 bins per direction it would visit every particle anyway, so skip the broad phase: 
+// take the minimum image of every other center and compare the squared distance against the diameter squared.
+// Blocks of SphereBatch::WIDTH are tested without an early exit so the compiler can vectorize them. Other 
+// cells go through the cell list as usual.
+// ========================================================================================================
+template <>
+inline bool MCDriver<Sphere>::CollisionDetectedWith(uint i, const Vector &s, MCStats &stats, int trial)
+{
+    bool minimum_image = true;
+    for(int d=0;d<3;d++)
+        if (this->cell_list.n_bins[d] < 2 || this->cell_list.n_bins[d] > 3)
+            minimum_image = false;
+
+    if (!minimum_image)
+        return this->CollisionDetectedInNeighborBins(i, s, stats, trial);
+
+    const Matrix &h = this->cell.h;
+    const Vector *coords = this->cell_list.coords.data();
+    double diameter = 2*Sphere::GetCircumradius();
+    double d2 = diameter*diameter;
+    uint n = this->particles.Size();
+
+    STATS_COUNT(stats, BROAD_CANDIDATES, n - 1);
+    STATS_COUNT(stats, NARROW_CALLS, n - 1);
+
+    for(uint j0=0;j0<n;j0+=SphereBatch::WIDTH)
+    {
+        uint j1 = std::min(n, j0 + SphereBatch::WIDTH);
+
+        bool hit = false;
+        for(uint j=j0;j<j1;j++)
+        {
+            // Both are wrapped into [0,1), so the minimum image is at most one cell length away
+            double dx = coords[j][0] - s[0], dy = coords[j][1] - s[1], dz = coords[j][2] - s[2];
+            dx -= (dx > .5) - (dx < -.5);
+            dy -= (dy > .5) - (dy < -.5);
+            dz -= (dz > .5) - (dz < -.5);
+
+            double x = h(0,0)*dx + h(0,1)*dy + h(0,2)*dz;
+            double y = h(1,0)*dx + h(1,1)*dy + h(1,2)*dz;
+            double z = h(2,0)*dx + h(2,1)*dy + h(2,2)*dz;
+
+            hit |= (j != i) & (x*x + y*y + z*z < d2);
+        }
+
+        if (hit)
+            return true;
+    }
+
+    return false;
+}
@@ -1,84 +1,114 @@
 
 #include "Moves.h"
+#include "Checkpoint.h"
 
 // Super Move constructor
-Move::Move(Real delta_max)
+Move::Move(Real delta_max, RNG *rng)
 {
     accepted_moves = 0;
     total_moves = 0;
     this->delta_max = delta_max;
+    this->rng = rng;
 
 }
 
 Move::~Move(){}
 
+void Move::Save(std::ostream &out)
+{
+    checkpoint::Write(out, this->delta_max);
+    checkpoint::Write(out, this->accepted_moves);
+    checkpoint::Write(out, this->total_moves);
+}
+
+void Move::Load(std::istream &in)
+{
+    checkpoint::Read(in, this->delta_max);
+    checkpoint::Read(in, this->accepted_moves);
+    checkpoint::Read(in, this->total_moves);
+}
+
 // ParticleMove super class
-ParticleMove::ParticleMove(Shape *t, Real delta_max): Move(delta_max)
+ParticleMove::ParticleMove(ParticleStore *particles, uint index, Real delta_max): Move(delta_max, NULL)
 {
-	this->particle = t;
-    for(uint i=0;i<this->particle->vertices.size();i++)
-        this->vertices_old.push_back(Vector(t->vertices[i]));
+	this->particles = particles;
+    this->index = index;
 }
 
-// ParticleTranslation class
-ParticleTranslation::ParticleTranslation(Shape *t, Real delta_max): ParticleMove(t, delta_max)
+void ParticleMove::Commit(uint trial)
 {
+    this->accepted_moves++;
+
+    this->particles->Copy(trial, this->index);
 }
 
-void ParticleTranslation::Apply()
+Real ParticleMove::GetDisplacement(uint trial)
 {
-    Move::Apply();
+    return this->particles->GetDisplacement(this->index, trial);
+}
 
-    for(uint i=0;i<this->particle->vertices.size();i++)
-        this->vertices_old[i] = this->particle->vertices[i];
+// ParticleTranslation class
+ParticleTranslation::ParticleTranslation(ParticleStore *particles, uint index, Real delta_max): ParticleMove(particles, index, delta_max)
+{
+}
 
-    // We remember the details of this move so that it can be undone later if it results in a collision  
-    // If dr exists, release that memory before creating a new vector
+void ParticleTranslation::Propose(uint trial, RNG &rng)
+{
+    this->total_moves++;
 
     Real delta = this->delta_max;
 
-    Vector dr(u(-delta, delta),
-             u(-delta, delta),
-             u(-delta, delta));
+    Real r[3];
+    rng.Fill(r, 3, -delta, delta);
+    Vector dr(r[0], r[1], r[2]);
 
-    this->particle->Translate(dr);
+    this->particles->Copy(this->index, trial);
+    this->particles->Translate(trial, dr);
 }
 
 // ParticleRotation class
-ParticleRotation::ParticleRotation(Shape *t, Real delta_max): ParticleMove(t, delta_max)
+ParticleRotation::ParticleRotation(ParticleStore *particles, uint index, Real delta_max): ParticleMove(particles, index, delta_max)
 {
 }
 
-void ParticleRotation::Apply()
+void ParticleRotation::Propose(uint trial, RNG &rng)
 {
-    Move::Apply();
-
-    for(uint i=0;i<this->particle->vertices.size();i++)
-        this->vertices_old[i] = this->particle->vertices[i];
+    this->total_moves++;
 
     Real delta = this->delta_max;
 
-    Real roll = u(-delta, delta);
-    Real pitch = u(-delta, delta);
-    Real yaw = u(-delta, delta);
+    // Small random rotation: the quaternion (1, w/2) turns by about |w| radians around w. Components of w are 
+    // uniform on [-delta, delta], so a rotation and its inverse are equally likely (symmetric proposal).
+    Real w[3];
+    rng.Fill(w, 3, -delta, delta);
 
-    this->particle->Rotate(roll, pitch, yaw);
+    this->particles->Copy(this->index, trial);
+    this->particles->Rotate(trial, Quaternion(1, .5*w[0], .5*w[1], .5*w[2]).normalized());
 }
-void ParticleMove::Undo()
+
+// EventChain class
+const Real EventChain::GAP = 1e-5;
+
+EventChain::EventChain(Real delta_max, RNG *rng): Move(delta_max, rng)
 {
-    Move::Undo();
-    for(uint i=0;i<this->particle->vertices.size();i++)
-        this->particle->vertices[i] = this->vertices_old[i];
+    this->direction = Vector(1, 0, 0);
+}
+
+void EventChain::Apply()
+{
+    Move::Apply();
+
+    this->direction = this->rng->Orientation() * Vector(1, 0, 0);
 }
 
 // CellMove super class
-CellMove::CellMove(Cell *c, Real delta_max): Move(delta_max)
+CellMove::CellMove(Cell *c, Real delta_max, RNG *rng): Move(delta_max, rng)
 {
 	this->cell = c;
 }
 
 // CellShape class
-CellShapeMove::CellShapeMove(Cell *c, Real delta_max): CellMove(c, delta_max)
+CellShapeMove::CellShapeMove(Cell *c, Real delta_max, RNG *rng): CellMove(c, delta_max, rng)
 {
 }
 
@@ -89,10 +119,13 @@ void CellShapeMove::Apply()
     // Generate a random strain tensor 
     Real delta = this->delta_max;
 
+    Real strain[9];
+    this->rng->Fill(strain, 9, -delta, delta);
+
     Matrix e;
-    e << u(-delta,delta), u(-delta,delta), u(-delta,delta),
-         u(-delta,delta), u(-delta,delta), u(-delta,delta),
-         u(-delta,delta), u(-delta,delta), u(-delta,delta);
+    e << strain[0], strain[1], strain[2],
+         strain[3], strain[4], strain[5],
+         strain[6], strain[7], strain[8];
 
     // Make strain tensor symmetric
     e(0,1) = e(1,0);
@@ -102,44 +135,17 @@ void CellShapeMove::Apply()
     // Record the strain tensor so we can undo this move after
     Matrix cell_update = Matrix::Identity() + e;
     this->h_old = this->cell->h;
+    this->h_old_inv = this->cell->GetInverse();
 
-    // We move the particles along with the cell tensor to aid compression
-    std::vector<Vector> s_com;
-    for(uint i=0;i<this->cell->particles.size();i++)   
-        s_com.push_back(this->cell->PartialCoords(this->cell->particles[i]->GetCOM()));
-
-    // Apply the strain tensor to update the cell
-    this->cell->h *= cell_update;
-
-    // Now apply the appropriate translations to each particle
-    for(uint i=0;i<this->cell->particles.size();i++)   
-    {
-        Shape *p = this->cell->particles[i];
-        Vector r_com(p->GetCOM());
-        Vector r_com_new(this->cell->h * s_com[i]);
-        p->Translate(r_com_new - r_com);
-    }
+    // Apply the strain tensor to update the cell. The particles move along with it (their fractional coordinates
+    // stay put) to aid compression, without touching any of them.
+    this->cell->SetTensor(this->cell->h * cell_update);
 }
+
 void CellMove::Undo()
 {
     Move::Undo();
 
-    // Copy Pasta from Apply() above
-    // We move the particles along with the cell tensor to aid compression
-    std::vector<Vector> s_com;
-    for(uint i=0;i<this->cell->particles.size();i++)   
-        s_com.push_back(this->cell->PartialCoords(this->cell->particles[i]->GetCOM()));
-
-    // Apply the strain tensor to update the cell
-    this->cell->h = this->h_old;
-
-    // Now apply the appropriate translations to each particle
-    for(uint i=0;i<this->cell->particles.size();i++)   
-    {
-        Shape *p = this->cell->particles[i];
-        Vector r_com(p->GetCOM());
-        Vector r_com_new(this->cell->h * s_com[i]);
-        p->Translate(r_com_new - r_com);
-    }
+    // The particles follow the cell back
+    this->cell->SetTensor(this->h_old);
 }
-
@@ -12,8 +12,12 @@ class Move
     Real delta_max;
     int accepted_moves, total_moves;
 
+    // Random numbers are drawn from the owning driver's generator (particle moves get theirs passed to Propose 
+    // instead, so the domains of a checkerboard sweep can each use their own)
+    RNG *rng;
+
     // Constructor/Destructor
-    Move(Real delta_max);
+    Move(Real delta_max, RNG *rng);
     virtual ~Move();
 
     // Virtual methods to be overloaded for specific move types
@@ -23,20 +27,34 @@ class Move
     // Some reporting functions for acceptance rates
     Real GetRatio(){return 1.*accepted_moves / total_moves;}
     void Reset(){accepted_moves = 0; total_moves = 0;}
+
+    // Checkpointing: move size and acceptance counters (the undo state only lives for the duration of one MC step)
+    void Save(std::ostream &out);
+    void Load(std::istream &in);
 };
 
-// Particle moves
+// Particle moves are proposed and committed rather than applied and undone: Propose writes the trial pose into a
+// trial slot of the store, where the collision tests look at it, and only Commit writes the particle itself. A
+// rejected move (most of them at high pressure) doesn't write the particle at all.
 class ParticleMove: public Move
 {
     public:
-    Shape *particle;
-    std::vector<Vector> vertices_old;
+    // The particle is `index` in `particles`
+    ParticleStore *particles;
+    uint index;
 
     // Constructor/Destructor
-    ParticleMove(Shape *t, Real delta_max);
+    ParticleMove(ParticleStore *particles, uint index, Real delta_max);
 
-    // All particle moves share a common Undo: vertices are reset to `vertices_old`
-    void Undo();
+    // Put the trial pose in trial slot `trial` of the store (see ParticleStore::GetTrial), drawing from `rng`
+    virtual void Propose(uint trial, RNG &rng) = 0;
+
+    // Accept the move: the particle takes the pose in `trial`
+    void Commit(uint trial);
+
+    // Largest distance any vertex moves from the particle to the trial pose (bounds how much a gap to this particle 
+    // can shrink)
+    Real GetDisplacement(uint trial);
 };
 
 class ParticleTranslation: public ParticleMove
@@ -44,10 +62,10 @@ class ParticleTranslation: public ParticleMove
     public:
         
     // Constructor
-    ParticleTranslation(Shape *t, Real delta_max);
+    ParticleTranslation(ParticleStore *particles, uint index, Real delta_max);
 
     // Translate the particle by a random displacement vector in R^3
-    void Apply();
+    void Propose(uint trial, RNG &rng);
 };
 
 class ParticleRotation: public ParticleMove
@@ -55,9 +73,34 @@ class ParticleRotation: public ParticleMove
     public:
 
     // Constructor
-    ParticleRotation(Shape *t, Real delta_max);
+    ParticleRotation(ParticleStore *particles, uint index, Real delta_max);
+
+    // Rotate the particle about its COM by a small random unit quaternion
+    void Propose(uint trial, RNG &rng);
+};
+
+// ========================================================================================================
+// EventChain - Rejection-free collective translation: one particle moves along a random direction until it
+//              touches another, which then carries on along the same direction with what's left of the chain, 
+//              and so on until the whole `delta_max` has been used up. This holds the chain parameters - the
+//              collision geometry is in MCDriver::MakeEventChain. Every chain counts as an accepted move.
+// ========================================================================================================
+class EventChain: public Move
+{
+    public:
+    // Direction of the current chain (unit vector)
+    Vector direction;
+
+    // Particles stop this far short of the contact, so round-off in the (single precision) overlap kernels can't 
+    // see the pair as overlapping afterwards
+    static const Real GAP;
+    // Give up on a chain after this many steps (only reachable when particles are jammed a GAP apart)
+    static const int MAX_STEPS = 10000;
+
+    // Constructor - `delta_max` is the chain length
+    EventChain(Real delta_max, RNG *rng);
 
-    // Rotate the particle by a set of 3 random angles (around the 3 principle (intrinsic) axes in R^3 (e_x, e_y, e_z))
+    // Start a new chain: the direction is uniform on the unit sphere
     void Apply();
 };
 
@@ -66,10 +109,10 @@ class CellMove: public Move
 {
     public:
     Cell *cell;
-    Matrix h_old;
+    Matrix h_old, h_old_inv;
 
     // Constructor/Destructor
-    CellMove(Cell *c, Real delta_max);
+    CellMove(Cell *c, Real delta_max, RNG *rng);
 
     void Undo();
 };
@@ -79,7 +122,7 @@ class CellShapeMove: public CellMove
     public:
     
     // Constructor
-    CellShapeMove(Cell *c, Real delta_max);
+    CellShapeMove(Cell *c, Real delta_max, RNG *rng);
 
     // Cell shape is updated by h_new = (I + e) * h where e is a symmetric strain tensor with small elements drawn from {-delta_max, delta_max}
     void Apply();
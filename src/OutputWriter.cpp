@@ -0,0 +1,93 @@
+#include <fstream>
+#include "OutputWriter.h"
+
+std::string ConfigurationToString(Cell &cell, ParticleStore &particles)
+{
+    std::string s = "";
+
+    // First, the cell tensor
+    s += cell.ToString();
+    s += "\n";
+
+    // Now the particles
+    for(uint i=0;i<particles.Size();i++)
+    {
+        s += particles.ToString(i) + "\n";
+    }
+
+    return s;
+}
+
+OutputWriter::Snapshot::Snapshot(const std::string &fname, Cell &cell, ParticleStore &particles): fname(fname), cell(cell), particles(particles)
+{
+    // The copy shouldn't point back at the live particles
+    this->cell.particles = NULL;
+}
+
+OutputWriter::OutputWriter(int capacity)
+{
+    this->capacity = std::max(1, capacity);
+    this->busy = false;
+    this->stopping = false;
+
+    this->worker = std::thread(&OutputWriter::WorkerLoop, this);
+}
+
+OutputWriter::~OutputWriter()
+{
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->stopping = true;
+    }
+    this->not_empty.notify_one();
+
+    this->worker.join();
+}
+
+void OutputWriter::Write(const std::string &fname, Cell &cell, ParticleStore &particles)
+{
+    std::unique_lock<std::mutex> guard(this->lock);
+    this->not_full.wait(guard, [this] { return this->queue.size() < this->capacity; });
+
+    this->queue.emplace_back(fname, cell, particles);
+    guard.unlock();
+
+    this->not_empty.notify_one();
+}
+
+void OutputWriter::Flush()
+{
+    std::unique_lock<std::mutex> guard(this->lock);
+    this->idle.wait(guard, [this] { return this->queue.empty() && !this->busy; });
+}
+
+// ========================================================================================================
+// WorkerLoop - Take snapshots off the queue and write them until stopped. The queue is drained before the
+//              thread exits, so nothing handed to Write() is lost.
+// ========================================================================================================
+void OutputWriter::WorkerLoop()
+{
+    std::unique_lock<std::mutex> guard(this->lock);
+    while(true)
+    {
+        this->not_empty.wait(guard, [this] { return !this->queue.empty() || this->stopping; });
+        if (this->queue.empty())
+            return;
+
+        Snapshot snapshot = std::move(this->queue.front());
+        this->queue.pop_front();
+        this->busy = true;
+        guard.unlock();
+        this->not_full.notify_one();
+
+        std::ofstream f;
+        f.open(snapshot.fname);
+        f << ConfigurationToString(snapshot.cell, snapshot.particles);
+        f.close();
+
+        guard.lock();
+        this->busy = false;
+        if (this->queue.empty())
+            this->idle.notify_all();
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Globals.h"
+#include "Cell.h"
+#include "ParticleStore.h"
+
+// Text form of a configuration as written to the output files: the cell tensor (one cell vector per line), then
+// one line of vertex coordinates per particle
+std::string ConfigurationToString(Cell &cell, ParticleStore &particles);
+
+// ========================================================================================================
+// OutputWriter - Writes configuration snapshots to text files on a background thread. Write() only copies
+//                the cell and particle state into a bounded queue; formatting and file I/O happen on the
+//                writer thread. When the queue is full, Write() blocks until there is room (backpressure),
+//                so a slow disk can't make the queue grow without bound. Files are written in the order
+//                they were queued.
+// ========================================================================================================
+class OutputWriter
+{
+    public:
+    // `capacity` is the maximum number of snapshots waiting to be written
+    OutputWriter(int capacity=64);
+    // Writes everything still queued before returning
+    ~OutputWriter();
+
+    // Queue a copy of `cell` and `particles` to be written to `fname`
+    void Write(const std::string &fname, Cell &cell, ParticleStore &particles);
+
+    // Block until every queued snapshot is on disk
+    void Flush();
+
+    private:
+    struct Snapshot
+    {
+        std::string fname;
+        Cell cell;
+        ParticleStore particles;
+
+        Snapshot(const std::string &fname, Cell &cell, ParticleStore &particles);
+    };
+
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable not_empty, not_full, idle;
+
+    std::deque<Snapshot> queue;
+    unsigned int capacity;
+    // The writer thread is formatting/writing a snapshot it already took off the queue
+    bool busy;
+    bool stopping;
+
+    void WorkerLoop();
+};
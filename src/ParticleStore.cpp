@@ -0,0 +1,250 @@
+#include "ParticleStore.h"
+#include "Checkpoint.h"
+
+ParticleStore::ParticleStore(const std::vector<Vector> &body)
+{
+    this->body = body;
+    this->n_vertices = body.size();
+    this->h = Matrix::Identity();
+    this->h_inv = Matrix::Identity();
+
+    // One trial slot for the serial moves
+    this->n_particles = 0;
+    this->n_trials = 0;
+    this->ReserveTrials(1);
+}
+
+// The new particle takes the place of the first trial slot (their contents don't outlive a move)
+uint ParticleStore::Add(const Vector &com, const Quaternion &q)
+{
+    uint i = this->n_particles++;
+    this->Resize(this->n_particles + this->n_trials);
+
+    this->SetFractional(i, this->h_inv * com);
+
+    Quaternion q_unit = q.normalized();
+    this->qw[i] = q_unit.w();
+    this->qx[i] = q_unit.x();
+    this->qy[i] = q_unit.y();
+    this->qz[i] = q_unit.z();
+
+    this->UpdateVertices(i);
+
+    return i;
+}
+
+uint ParticleStore::Size()
+{
+    return this->n_particles;
+}
+
+uint ParticleStore::GetTrial(int k)
+{
+    return this->n_particles + k;
+}
+
+void ParticleStore::ReserveTrials(int n)
+{
+    if (n <= this->n_trials)
+        return;
+
+    this->n_trials = n;
+    this->Resize(this->n_particles + this->n_trials);
+}
+
+void ParticleStore::Resize(uint n)
+{
+    this->sx.resize(n);
+    this->sy.resize(n);
+    this->sz.resize(n);
+
+    this->qw.resize(n);
+    this->qx.resize(n);
+    this->qy.resize(n);
+    this->qz.resize(n);
+
+    this->vx.resize(n*this->n_vertices);
+    this->vy.resize(n*this->n_vertices);
+    this->vz.resize(n*this->n_vertices);
+}
+
+// Called by the cell whenever its tensor changes; the particles keep their fractional coordinates, so their
+// Cartesian COMs follow the cell (an affine deformation of the packing) without any per-particle work
+void ParticleStore::SetLattice(const Matrix &h, const Matrix &h_inv)
+{
+    this->h = h;
+    this->h_inv = h_inv;
+}
+
+void ParticleStore::SetFractional(uint i, const Vector &s)
+{
+    this->sx[i] = s[0];
+    this->sy[i] = s[1];
+    this->sz[i] = s[2];
+}
+
+Quaternion ParticleStore::GetOrientation(uint i)
+{
+    return Quaternion(this->qw[i], this->qx[i], this->qy[i], this->qz[i]);
+}
+
+Vector ParticleStore::GetVertex(uint i, int k)
+{
+    return this->GetCOM(i) + this->GetVertexOffset(i, k);
+}
+
+// ========================================================================================================
+// UpdateVertices - Body-frame vertices rotated by the orientation. Since the vertices are always rebuilt from 
+//                  the pose, no rounding error accumulates in the shape itself.
+// ========================================================================================================
+void ParticleStore::UpdateVertices(uint i)
+{
+    Matrix r = this->GetOrientation(i).toRotationMatrix();
+
+    uint v0 = i*this->n_vertices;
+    for(int k=0;k<this->n_vertices;k++)
+    {
+        Vector v = r * this->body[k];
+        this->vx[v0+k] = v[0];
+        this->vy[v0+k] = v[1];
+        this->vz[v0+k] = v[2];
+    }
+}
+
+// Translations leave the orientation, and with it the cached vertices, alone
+void ParticleStore::Translate(uint i, const Vector &dr)
+{
+    Vector ds = this->h_inv * dr;
+    this->sx[i] += ds[0];
+    this->sy[i] += ds[1];
+    this->sz[i] += ds[2];
+}
+
+// ========================================================================================================
+// Rotate - Compose rotation `dq` into the orientation of particle `i` (rotating it in place about its COM)
+// ========================================================================================================
+void ParticleStore::Rotate(uint i, const Quaternion &dq)
+{
+    Quaternion q = dq * this->GetOrientation(i);
+
+    // Renormalize so the orientation stays a pure rotation however many moves are composed into it
+    q.normalize();
+
+    this->qw[i] = q.w();
+    this->qx[i] = q.x();
+    this->qy[i] = q.y();
+    this->qz[i] = q.z();
+
+    this->UpdateVertices(i);
+}
+
+void ParticleStore::Copy(uint i, uint j)
+{
+    this->sx[j] = this->sx[i];
+    this->sy[j] = this->sy[i];
+    this->sz[j] = this->sz[i];
+
+    this->qw[j] = this->qw[i];
+    this->qx[j] = this->qx[i];
+    this->qy[j] = this->qy[i];
+    this->qz[j] = this->qz[i];
+
+    uint v_i = i*this->n_vertices, v_j = j*this->n_vertices;
+    for(int k=0;k<this->n_vertices;k++)
+    {
+        this->vx[v_j+k] = this->vx[v_i+k];
+        this->vy[v_j+k] = this->vy[v_i+k];
+        this->vz[v_j+k] = this->vz[v_i+k];
+    }
+}
+
+void ParticleStore::GetPose(uint i, Pose &pose)
+{
+    pose.s = this->GetFractional(i);
+    pose.q = this->GetOrientation(i);
+}
+
+void ParticleStore::SetPose(uint i, const Pose &pose)
+{
+    this->SetFractional(i, pose.s);
+
+    this->qw[i] = pose.q.w();
+    this->qx[i] = pose.q.x();
+    this->qy[i] = pose.q.y();
+    this->qz[i] = pose.q.z();
+
+    this->UpdateVertices(i);
+}
+
+Real ParticleStore::GetDisplacement(uint i, uint j)
+{
+    Vector dr = this->h * (this->GetFractional(j) - this->GetFractional(i));
+
+    Real d = 0;
+    for(int k=0;k<this->n_vertices;k++)
+        d = std::max(d, (Real)(dr + this->GetVertexOffset(j, k) - this->GetVertexOffset(i, k)).norm());
+
+    return d;
+}
+
+// ========================================================================================================
+// ToString - Return a formatted string of particle `i`'s coordinates (v1x, v1y, v1z, v2x, v2y, ... )
+// ========================================================================================================
+std::string ParticleStore::ToString(uint i)
+{
+    std::string s = "";
+    Vector com = this->GetCOM(i);
+    for(int k=0;k<this->n_vertices;k++)
+    {
+        Vector v = com + this->GetVertexOffset(i, k);
+        for(int j=0;j<3;j++)
+            s += std::to_string(v[j]) + " ";
+    }
+
+    return s;
+}
+
+// Only the particles are saved, the trial slots are scratch
+static void WriteParticles(std::ostream &out, const std::vector<double> &v, uint n)
+{
+    checkpoint::WriteVector(out, std::vector<double>(v.begin(), v.begin() + n));
+}
+
+void ParticleStore::Save(std::ostream &out)
+{
+    uint n = this->n_particles;
+    WriteParticles(out, this->sx, n);
+    WriteParticles(out, this->sy, n);
+    WriteParticles(out, this->sz, n);
+
+    WriteParticles(out, this->qw, n);
+    WriteParticles(out, this->qx, n);
+    WriteParticles(out, this->qy, n);
+    WriteParticles(out, this->qz, n);
+}
+
+void ParticleStore::Load(std::istream &in)
+{
+    checkpoint::ReadVector(in, this->sx);
+    checkpoint::ReadVector(in, this->sy);
+    checkpoint::ReadVector(in, this->sz);
+
+    checkpoint::ReadVector(in, this->qw);
+    checkpoint::ReadVector(in, this->qx);
+    checkpoint::ReadVector(in, this->qy);
+    checkpoint::ReadVector(in, this->qz);
+
+    // Every array must describe the same number of particles
+    uint n = this->sx.size();
+    if (this->sy.size() != n || this->sz.size() != n || this->qw.size() != n || 
+        this->qx.size() != n || this->qy.size() != n || this->qz.size() != n)
+    {
+        in.setstate(std::ios::failbit);
+        return;
+    }
+
+    this->n_particles = n;
+    this->Resize(n + this->n_trials);
+    for(uint i=0;i<n;i++)
+        this->UpdateVertices(i);
+}
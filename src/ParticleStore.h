@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "Globals.h"
+
+// ========================================================================================================
+// ParticleStore - Contiguous state for all particles of one driver, addressed by index. Every particle is
+//                 the same rigid body (`body`: vertices relative to the COM), placed by a COM and a unit
+//                 quaternion - that pose is the state. The COM is held in fractional coordinates of the cell
+//                 tensor `h`, so a cell move only replaces h and the particles follow without being touched;
+//                 Cartesian COMs are derived from h on demand. The rotated body vertices only depend on the 
+//                 orientation: they are regenerated after every rotation and cached next to each other 
+//                 (n_vertices per particle) so the collision tests read them without chasing pointers. All arrays 
+//                 are structure-of-arrays.
+//
+//                 Past the Size() particles the arrays hold a few trial slots: scratch particles a move writes its 
+//                 proposed pose into, so the collision tests can look at it without touching the particle itself
+//                 (see ParticleMove). Each concurrent mover needs its own slot.
+// ========================================================================================================
+class ParticleStore
+{
+    public:
+    // Body-frame vertices shared by every particle
+    std::vector<Vector> body;
+    int n_vertices;
+
+    // Cell tensor the fractional coordinates refer to, and its inverse (kept up to date by Cell::SetTensor; the 
+    // identity for a store without a cell, where fractional and Cartesian coordinates are the same)
+    Matrix h, h_inv;
+
+    // Center of mass in fractional coordinates
+    std::vector<double> sx, sy, sz;
+
+    // Orientation (unit quaternion w + xi + yj + zk mapping the body frame to the world frame)
+    std::vector<double> qw, qx, qy, qz;
+
+    // Cached rotated body vertices (relative to the COM): vertex k of particle i is at index i*n_vertices + k
+    std::vector<double> vx, vy, vz;
+
+    // Everything that places a particle (e.g. to set up a configuration by hand)
+    struct Pose
+    {
+        Vector s;
+        Quaternion q;
+    };
+
+    // Constructor
+    ParticleStore(const std::vector<Vector> &body);
+
+    // Append a particle at (Cartesian) `com` with orientation `q`, returns its index
+    uint Add(const Vector &com, const Quaternion &q);
+    uint Size();
+
+    // Index of trial slot `k`, and making sure there are at least `n` of them (this moves the slots around, so not 
+    // while any are in use)
+    uint GetTrial(int k);
+    void ReserveTrials(int n);
+
+    void SetLattice(const Matrix &h, const Matrix &h_inv);
+
+    // Cartesian COM and vertices (h times the fractional COM, plus the rotated body vertex)
+    Vector GetCOM(uint i);
+    Quaternion GetOrientation(uint i);
+    Vector GetVertex(uint i, int k);
+    // Vertex `k` of particle `i` relative to its COM
+    Vector GetVertexOffset(uint i, int k);
+
+    Vector GetFractional(uint i);
+    void SetFractional(uint i, const Vector &s);
+
+    // Rigid body updates (`dr` is Cartesian; rotations are about the COM)
+    void Translate(uint i, const Vector &dr);
+    void Rotate(uint i, const Quaternion &dq);
+
+    // Overwrite the pose (and vertices) of particle or trial slot `j` with those of `i`
+    void Copy(uint i, uint j);
+
+    void GetPose(uint i, Pose &pose);
+    void SetPose(uint i, const Pose &pose);
+
+    // Largest distance between corresponding vertices of particles (or trial slots) `i` and `j`
+    Real GetDisplacement(uint i, uint j);
+
+    // Vertex coordinates (v1x, v1y, v1z, v2x, v2y, ... ) as written to the output files
+    std::string ToString(uint i);
+
+    // Checkpointing: the poses (fractional COMs) are stored verbatim (no renormalization on load) and the vertices 
+    // are rebuilt
+    void Save(std::ostream &out);
+    void Load(std::istream &in);
+
+    private:
+    uint n_particles;
+    int n_trials;
+
+    // Regenerate the rotated body vertices of particle `i` from its orientation
+    void UpdateVertices(uint i);
+
+    // Resize every array to `n` particles/slots
+    void Resize(uint n);
+};
+
+// The broad and narrow phases place every candidate through these, so they are inlined
+inline Vector ParticleStore::GetCOM(uint i)
+{
+    double s[3] = {this->sx[i], this->sy[i], this->sz[i]};
+    const Matrix &h = this->h;
+
+    return Vector(h(0,0)*s[0] + h(0,1)*s[1] + h(0,2)*s[2],
+                  h(1,0)*s[0] + h(1,1)*s[1] + h(1,2)*s[2],
+                  h(2,0)*s[0] + h(2,1)*s[1] + h(2,2)*s[2]);
+}
+
+inline Vector ParticleStore::GetFractional(uint i)
+{
+    return Vector(this->sx[i], this->sy[i], this->sz[i]);
+}
+
+inline Vector ParticleStore::GetVertexOffset(uint i, int k)
+{
+    uint v = i*this->n_vertices + k;
+    return Vector(this->vx[v], this->vy[v], this->vz[v]);
+}
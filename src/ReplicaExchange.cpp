@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include "ReplicaExchange.h"
+#include "Checkpoint.h"
+
+ReplicaExchange::ReplicaExchange(const std::vector<Real> &pressures, int interval, int adapt_interval)
+{
+    int n = pressures.size();
+
+    // Rung k goes to the replica with the k-th lowest starting pressure (ties keep the replica order)
+    this->replica.resize(n);
+    for(int r=0;r<n;r++)
+        this->replica[r] = r;
+    std::stable_sort(this->replica.begin(), this->replica.end(), [&](int a, int b) { return pressures[a] < pressures[b]; });
+
+    this->ladder.resize(n);
+    for(int k=0;k<n;k++)
+        this->ladder[k] = pressures[this->replica[k]];
+
+    int n_pairs = std::max(0, n - 1);
+    this->attempts.assign(n_pairs, 0);
+    this->accepts.assign(n_pairs, 0);
+    this->window_attempts.assign(n_pairs, 0);
+    this->window_accepts.assign(n_pairs, 0);
+
+    this->direction.assign(n, NONE);
+    this->trip_start.assign(n, 0);
+    this->n_round_trips = 0;
+    this->round_trip_steps = 0;
+
+    this->interval = std::max(1, interval);
+    this->next_sweep = 0;
+    this->n_sweeps = 0;
+    this->adapt_interval = adapt_interval;
+}
+
+bool ReplicaExchange::Due(int64_t step)
+{
+    if (step < this->next_sweep)
+        return false;
+
+    this->next_sweep = (step/this->interval + 1)*this->interval;
+    return true;
+}
+
+void ReplicaExchange::Sweep(const std::vector<Real> &volumes, int64_t step, RNG &rng)
+{
+    int n = this->ladder.size();
+
+    for(int k=this->n_sweeps % 2;k+1<n;k+=2)
+    {
+        int r0 = this->replica[k];
+        int r1 = this->replica[k+1];
+        Real dP = this->ladder[k+1] - this->ladder[k];
+        Real dV = volumes[r1] - volumes[r0];
+
+        this->attempts[k]++;
+        this->window_attempts[k]++;
+
+        if (rng.u(0, 1) < exp(dP*dV))
+        {
+            std::swap(this->replica[k], this->replica[k+1]);
+            this->accepts[k]++;
+            this->window_accepts[k]++;
+        }
+    }
+
+    this->n_sweeps++;
+    this->UpdateDirections(step);
+
+    if (this->adapt_interval > 0 && this->n_sweeps % this->adapt_interval == 0)
+        this->Adapt();
+}
+
+// Relabel the replicas at either end of the ladder, closing a round trip for one that came back down
+void ReplicaExchange::UpdateDirections(int64_t step)
+{
+    int n = this->ladder.size();
+    if (n < 2)
+        return;
+
+    int bottom = this->replica[0];
+    if (this->direction[bottom] == DOWN)
+    {
+        this->n_round_trips++;
+        this->round_trip_steps += step - this->trip_start[bottom];
+    }
+    if (this->direction[bottom] != UP)
+    {
+        this->direction[bottom] = UP;
+        this->trip_start[bottom] = step;
+    }
+
+    int top = this->replica[n-1];
+    if (this->direction[top] == UP)
+        this->direction[top] = DOWN;
+}
+
+// Rescale the gaps between rungs by how their acceptance compares to the mean over the last window: pairs
+// that swap more often than average are spread apart, pairs that rarely swap are pulled together
+void ReplicaExchange::Adapt()
+{
+    int n = this->ladder.size();
+    if (n < 3)
+        return;
+
+    bool log_scale = this->ladder[0] > 0;
+    std::vector<double> x(n);
+    for(int k=0;k<n;k++)
+        x[k] = log_scale ? log((double)this->ladder[k]) : this->ladder[k];
+
+    double mean = 0;
+    int n_measured = 0;
+    for(int k=0;k+1<n;k++)
+        if (this->window_attempts[k] > 0)
+        {
+            mean += double(this->window_accepts[k]) / this->window_attempts[k];
+            n_measured++;
+        }
+
+    if (n_measured == 0)
+        return;
+    mean /= n_measured;
+
+    // The offset keeps a pair that never swapped from collapsing completely
+    const double floor = 0.05;
+    std::vector<double> gap(n-1);
+    double span = x[n-1] - x[0], total = 0;
+    for(int k=0;k+1<n;k++)
+    {
+        gap[k] = x[k+1] - x[k];
+        if (this->window_attempts[k] > 0)
+            gap[k] *= (double(this->window_accepts[k]) / this->window_attempts[k] + floor) / (mean + floor);
+        total += gap[k];
+    }
+
+    if (total > 0)
+        for(int k=1;k+1<n;k++)
+        {
+            x[k] = x[k-1] + gap[k-1]*span/total;
+            this->ladder[k] = log_scale ? exp(x[k]) : x[k];
+        }
+
+    std::fill(this->window_attempts.begin(), this->window_attempts.end(), 0);
+    std::fill(this->window_accepts.begin(), this->window_accepts.end(), 0);
+}
+
+Real ReplicaExchange::GetPressure(int r)
+{
+    for(uint k=0;k<this->replica.size();k++)
+        if (this->replica[k] == r)
+            return this->ladder[k];
+
+    return 0;
+}
+
+Real ReplicaExchange::GetAcceptance(int k)
+{
+    if (this->attempts[k] == 0)
+        return 0;
+
+    return Real(this->accepts[k]) / this->attempts[k];
+}
+
+Real ReplicaExchange::GetMeanRoundTrip()
+{
+    if (this->n_round_trips == 0)
+        return 0;
+
+    return this->round_trip_steps / this->n_round_trips;
+}
+
+std::string ReplicaExchange::ToString()
+{
+    std::ostringstream out;
+
+    out << "Swap Accept Ratio (P_k <-> P_k+1): ";
+    for(uint k=0;k<this->attempts.size();k++)
+        out << this->ladder[k] << "<->" << this->ladder[k+1] << ": " << this->GetAcceptance(k) << ", ";
+    out << std::endl;
+
+    out << "Round Trips: " << this->n_round_trips << " (mean " << this->GetMeanRoundTrip() << " steps)" << std::endl;
+
+    return out.str();
+}
+
+void ReplicaExchange::Save(std::ostream &out)
+{
+    checkpoint::WriteVector(out, this->ladder);
+    checkpoint::WriteVector(out, this->replica);
+    checkpoint::WriteVector(out, this->attempts);
+    checkpoint::WriteVector(out, this->accepts);
+    checkpoint::WriteVector(out, this->window_attempts);
+    checkpoint::WriteVector(out, this->window_accepts);
+    checkpoint::WriteVector(out, this->direction);
+    checkpoint::WriteVector(out, this->trip_start);
+    checkpoint::Write(out, this->n_round_trips);
+    checkpoint::Write(out, this->round_trip_steps);
+    checkpoint::Write(out, this->next_sweep);
+    checkpoint::Write(out, this->n_sweeps);
+}
+
+void ReplicaExchange::Load(std::istream &in)
+{
+    uint n = this->ladder.size();
+
+    checkpoint::ReadVector(in, this->ladder);
+    checkpoint::ReadVector(in, this->replica);
+    checkpoint::ReadVector(in, this->attempts);
+    checkpoint::ReadVector(in, this->accepts);
+    checkpoint::ReadVector(in, this->window_attempts);
+    checkpoint::ReadVector(in, this->window_accepts);
+    checkpoint::ReadVector(in, this->direction);
+    checkpoint::ReadVector(in, this->trip_start);
+    checkpoint::Read(in, this->n_round_trips);
+    checkpoint::Read(in, this->round_trip_steps);
+    checkpoint::Read(in, this->next_sweep);
+    checkpoint::Read(in, this->n_sweeps);
+
+    if (this->ladder.size() != n || this->replica.size() != n || this->direction.size() != n)
+        in.setstate(std::ios::failbit);
+}
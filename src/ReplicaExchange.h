@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Globals.h"
+
+// ========================================================================================================
+// ReplicaExchange - Parallel tempering scheduler over a sorted pressure ladder. Replicas keep their
+//                   configurations and trade pressures: every `interval` MC steps one sweep proposes a swap
+//                   for every other neighboring pair of rungs, alternating between the even (0-1, 2-3, ...)
+//                   and odd (1-2, 3-4, ...) pairs. A swap between pressures P0 < P1 held by replicas with
+//                   volumes V0, V1 is accepted with probability min(1, exp((P1-P0)(V1-V0))).
+//
+// Acceptance is counted per pair of rungs. Each replica is labeled by the end of the ladder it visited last,
+// and a round trip is counted whenever a replica gets back to the lowest pressure after reaching the highest.
+// With `adapt_interval` > 0, the inner rungs are moved every `adapt_interval` sweeps to even out the swap
+// acceptance of all pairs (in log P when every pressure is positive), keeping both ends of the ladder fixed.
+// ========================================================================================================
+class ReplicaExchange
+{
+    public:
+    // Pressure of each rung (ascending) and the replica currently holding it
+    std::vector<Real> ladder;
+    std::vector<int> replica;
+
+    // Swap statistics for the pair of rungs (k, k+1): over the whole run, and since the last ladder update
+    std::vector<uint64_t> attempts, accepts;
+    std::vector<uint64_t> window_attempts, window_accepts;
+
+    // Per replica: end of the ladder visited last (see Direction) and the step its current round trip started
+    std::vector<int> direction;
+    std::vector<int64_t> trip_start;
+    uint64_t n_round_trips;
+    double round_trip_steps;
+
+    // MC steps between sweeps, the step the next sweep is due, and sweeps between ladder updates (0 = fixed ladder)
+    int interval;
+    int64_t next_sweep;
+    uint64_t n_sweeps;
+    int adapt_interval;
+
+    enum Direction { NONE = 0, UP = 1, DOWN = -1 };
+
+    // `pressures[r]` is the starting pressure of replica r - the ladder is those pressures in ascending order
+    ReplicaExchange(const std::vector<Real> &pressures, int interval, int adapt_interval=0);
+
+    // True once a sweep is due at `step` (then schedules the next one)
+    bool Due(int64_t step);
+
+    // One even/odd sweep at `step` given the current volume of every replica
+    void Sweep(const std::vector<Real> &volumes, int64_t step, RNG &rng);
+
+    // Pressure currently assigned to replica r
+    Real GetPressure(int r);
+    // Fraction of accepted swaps between rungs k and k+1
+    Real GetAcceptance(int k);
+    // Mean number of MC steps per completed round trip (0 until the first one)
+    Real GetMeanRoundTrip();
+
+    // Per-pair acceptance and round trip summary for the progress reports
+    std::string ToString();
+
+    // Checkpointing (the interval and adapt_interval are parameters of the run and aren't stored)
+    void Save(std::ostream &out);
+    void Load(std::istream &in);
+
+    private:
+    void UpdateDirections(int64_t step);
+    void Adapt();
+};
@@ -0,0 +1,341 @@
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include "ReplicaLink.h"
+
+static const char HELLO[4] = {'T', 'R', 'L', 'H'};
+static const char REQUEST[4] = {'T', 'R', 'L', 'Q'};
+static const char REPLY[4] = {'T', 'R', 'L', 'A'};
+
+// Read/write exactly n bytes (sockets can return short counts)
+static bool WriteAll(int fd, const void *buffer, size_t n)
+{
+    const char *p = static_cast<const char*>(buffer);
+    while(n > 0)
+    {
+        ssize_t k = write(fd, p, n);
+        if (k <= 0)
+            return false;
+        p += k;
+        n -= k;
+    }
+    return true;
+}
+
+static bool ReadAll(int fd, void *buffer, size_t n)
+{
+    char *p = static_cast<char*>(buffer);
+    while(n > 0)
+    {
+        ssize_t k = read(fd, p, n);
+        if (k <= 0)
+            return false;
+        p += k;
+        n -= k;
+    }
+    return true;
+}
+
+// Resolve `address` (unix:<path> or <host>:<port>) into a socket address. An empty host means any interface.
+static bool Resolve(const std::string &address, bool passive, sockaddr_storage &addr, socklen_t &len)
+{
+    memset(&addr, 0, sizeof(addr));
+
+    if (address.compare(0, 5, "unix:") == 0)
+    {
+        std::string path = address.substr(5);
+        sockaddr_un *un = reinterpret_cast<sockaddr_un*>(&addr);
+        if (path.empty() || path.size() >= sizeof(un->sun_path))
+            return false;
+
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, path.c_str());
+        len = sizeof(sockaddr_un);
+        return true;
+    }
+
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos)
+        return false;
+    std::string host = address.substr(0, colon), port = address.substr(colon + 1);
+
+    addrinfo hints, *result;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    if (getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints, &result) != 0)
+        return false;
+
+    memcpy(&addr, result->ai_addr, result->ai_addrlen);
+    len = result->ai_addrlen;
+    freeaddrinfo(result);
+    return true;
+}
+
+ReplicaLink::ReplicaLink(int rank, int n_procs)
+{
+    this->rank = rank;
+    this->n_procs = n_procs;
+    this->listener = -1;
+    this->n_replicas = 0;
+}
+
+ReplicaLink::~ReplicaLink()
+{
+    for(uint k=0;k<this->peers.size();k++)
+        if (this->peers[k] >= 0)
+            close(this->peers[k]);
+
+    if (this->listener >= 0)
+        close(this->listener);
+    if (!this->unix_path.empty())
+        unlink(this->unix_path.c_str());
+}
+
+ReplicaLink::Header::Header()
+{
+    memset(this, 0, sizeof(*this));
+}
+
+ReplicaLink::Header::Header(const char magic[4], uint32_t rank, int64_t step, uint32_t count)
+{
+    memset(this, 0, sizeof(*this));
+    memcpy(this->magic, magic, 4);
+    this->rank = rank;
+    this->step = step;
+    this->count = count;
+}
+
+void ReplicaLink::GetRange(int n_replicas, int rank, int n_procs, int &first, int &last)
+{
+    first = (int64_t)n_replicas*rank/n_procs;
+    last = (int64_t)n_replicas*(rank + 1)/n_procs;
+}
+
+bool ReplicaLink::Connect(const std::string &address, int timeout, const std::vector<Real> &ladder)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout);
+    this->n_replicas = ladder.size();
+    std::vector<float> own_ladder(ladder.begin(), ladder.end());
+
+    if (this->rank == 0)
+    {
+        if (!this->Listen(address))
+        {
+            this->error = "can't listen on " + address;
+            return false;
+        }
+
+        // Every rank introduces itself with a hello, so the connections can arrive in any order
+        this->peers.assign(this->n_procs, -1);
+        for(int n=1;n<this->n_procs;n++)
+        {
+            int wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            pollfd p = {this->listener, POLLIN, 0};
+            if (wait <= 0 || poll(&p, 1, wait) <= 0)
+            {
+                this->error = "timed out waiting for the other ranks";
+                return false;
+            }
+
+            int fd = accept(this->listener, NULL, NULL);
+            Header hello;
+            std::vector<float> hello_ladder;
+            if (fd < 0 || !this->Receive(fd, HELLO, 0, hello, hello_ladder, 1) || hello.rank == 0 ||
+                hello.rank >= (uint32_t)this->n_procs || this->peers[hello.rank] >= 0)
+            {
+                if (fd >= 0)
+                    close(fd);
+                this->error = "unexpected hello from another process";
+                return false;
+            }
+
+            this->peers[hello.rank] = fd;
+            if (hello.count != (uint32_t)this->n_replicas)
+            {
+                this->error = "rank " + std::to_string(hello.rank) + " runs " + std::to_string(hello.count) +
+                              " drivers, rank 0 runs " + std::to_string(this->n_replicas);
+                return false;
+            }
+            if (hello_ladder != own_ladder)
+            {
+                this->error = "rank " + std::to_string(hello.rank) + " has a different pressure ladder (p0, p1, ...)";
+                return false;
+            }
+        }
+
+        // Everyone agrees - let them start
+        for(int r=1;r<this->n_procs;r++)
+        {
+            if (!this->Send(this->peers[r], Header(HELLO, 0, 0, this->n_replicas), std::vector<float>()))
+            {
+                this->error = "rank " + std::to_string(r) + " went away";
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    while(std::chrono::steady_clock::now() < deadline)
+    {
+        int fd = this->Dial(address);
+        if (fd >= 0)
+        {
+            // Rank 0 closes the connection instead of welcoming us if the runs don't match
+            Header welcome;
+            std::vector<float> none;
+            this->peers.assign(1, fd);
+            if (!this->Send(fd, Header(HELLO, this->rank, 0, this->n_replicas), own_ladder) ||
+                !this->Receive(fd, HELLO, 0, welcome, none, 0))
+            {
+                this->error = "rank 0 rejected this process (different n_drivers or pressure ladder?)";
+                return false;
+            }
+
+            return true;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    this->error = "timed out waiting for rank 0";
+    return false;
+}
+
+bool ReplicaLink::Listen(const std::string &address)
+{
+    sockaddr_storage addr;
+    socklen_t len;
+    if (!Resolve(address, true, addr, len))
+        return false;
+
+    this->listener = socket(addr.ss_family, SOCK_STREAM, 0);
+    if (this->listener < 0)
+        return false;
+
+    if (addr.ss_family == AF_UNIX)
+    {
+        // A socket file left behind by a previous run would make bind fail
+        this->unix_path = reinterpret_cast<sockaddr_un*>(&addr)->sun_path;
+        unlink(this->unix_path.c_str());
+    }
+    else
+    {
+        int on = 1;
+        setsockopt(this->listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+
+    return bind(this->listener, reinterpret_cast<sockaddr*>(&addr), len) == 0 && listen(this->listener, this->n_procs) == 0;
+}
+
+int ReplicaLink::Dial(const std::string &address)
+{
+    sockaddr_storage addr;
+    socklen_t len;
+    if (!Resolve(address, false, addr, len))
+        return -1;
+
+    int fd = socket(addr.ss_family, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), len) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    // The messages are tiny and every one of them is waited on
+    if (addr.ss_family != AF_UNIX)
+    {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+
+    return fd;
+}
+
+bool ReplicaLink::Send(int fd, const Header &header, const std::vector<float> &data)
+{
+    return WriteAll(fd, &header, sizeof(header)) && WriteAll(fd, data.data(), data.size()*sizeof(float));
+}
+
+bool ReplicaLink::Receive(int fd, const char magic[4], int64_t step, Header &header, std::vector<float> &data, uint32_t per_replica)
+{
+    // Every process runs the same step loop, so a message for another step means the runs have diverged
+    if (!ReadAll(fd, &header, sizeof(header)) || memcmp(header.magic, magic, 4) != 0 || header.step != step || header.count > (1u << 24))
+        return false;
+
+    data.resize(header.count*per_replica);
+    return ReadAll(fd, data.data(), data.size()*sizeof(float));
+}
+
+bool ReplicaLink::Exchange(int64_t step, std::vector<Real> &pressures, const std::vector<Real> &volumes,
+                           std::function<void(std::vector<Real>&, const std::vector<Real>&)> sweep)
+{
+    Header header;
+    std::vector<float> data;
+
+    if (this->rank != 0)
+    {
+        for(uint j=0;j<pressures.size();j++)
+        {
+            data.push_back(pressures[j]);
+            data.push_back(volumes[j]);
+        }
+
+        if (!this->Send(this->peers[0], Header(REQUEST, this->rank, step, pressures.size()), data) ||
+            !this->Receive(this->peers[0], REPLY, step, header, data, 1) || header.count != pressures.size())
+            return false;
+
+        for(uint j=0;j<pressures.size();j++)
+            pressures[j] = data[j];
+        return true;
+    }
+
+    // Gather everything in rank order: our own replicas come first. Every rank has to send exactly its block.
+    std::vector<Real> all_pressures(pressures), all_volumes(volumes);
+    std::vector<uint32_t> counts(this->n_procs, pressures.size());
+    for(int r=1;r<this->n_procs;r++)
+    {
+        int first, last;
+        GetRange(this->n_replicas, r, this->n_procs, first, last);
+        counts[r] = last - first;
+
+        if (!this->Receive(this->peers[r], REQUEST, step, header, data, 2) || header.rank != (uint32_t)r ||
+            header.count != counts[r])
+            return false;
+
+        for(uint k=0;k<header.count;k++)
+        {
+            all_pressures.push_back(data[2*k]);
+            all_volumes.push_back(data[2*k + 1]);
+        }
+    }
+
+    sweep(all_pressures, all_volumes);
+
+    uint offset = pressures.size();
+    for(uint j=0;j<pressures.size();j++)
+        pressures[j] = all_pressures[j];
+
+    for(int r=1;r<this->n_procs;r++)
+    {
+        data.assign(all_pressures.begin() + offset, all_pressures.begin() + offset + counts[r]);
+        offset += counts[r];
+
+        if (!this->Send(this->peers[r], Header(REPLY, 0, step, counts[r]), data))
+            return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "Globals.h"
+
+// ========================================================================================================
+// ReplicaLink - Connects the processes of a multi-process run so they can share one tempering ladder. Every
+//               process hosts a contiguous block of the replicas; rank 0 also acts as the coordinator. At a
+//               sweep, every other rank sends the (BetaP, volume) of its replicas, rank 0 runs the sweep over
+//               all of them and sends each rank back the new pressures of its own replicas. Nothing else
+//               crosses the wire, so one exchange is 8 bytes per replica plus a small header.
+//
+// The address is either `unix:<path>` (a Unix domain socket, for processes on one box) or `<host>:<port>`
+// (TCP, for processes on several nodes). Rank 0 listens on it, the other ranks connect to it.
+//
+//   hello:    char magic[4] = "TRLH", uint32 rank, int64 step = 0, uint32 n_replicas, float32 ladder[n_replicas]
+//   welcome:  char magic[4] = "TRLH", uint32 rank = 0, int64 step = 0, uint32 n_replicas
+//   request:  char magic[4] = "TRLQ", uint32 rank, int64 step, uint32 count, float32 {BetaP, V}[count]
+//   reply:    char magic[4] = "TRLA", uint32 rank, int64 step, uint32 count, float32 BetaP[count]
+//
+// Every header is 24 bytes (4 of them padding, always zero). Rank 0 only welcomes the other ranks once all of them
+// have said hello with the same replica count and pressure ladder as its own, and from then on expects exactly
+// the GetRange block of replicas from each. Values are in the native byte order, so every process has to run on
+// the same platform.
+// ========================================================================================================
+class ReplicaLink
+{
+    public:
+    int rank, n_procs;
+
+    // Why the last Connect failed
+    std::string error;
+
+    ReplicaLink(int rank, int n_procs);
+    ~ReplicaLink();
+
+    // Rank 0 waits for every other rank to connect, the others keep retrying until rank 0 is up. Gives up
+    // after `timeout` seconds. `ladder` is the initial pressure of every replica of the run, which all the ranks
+    // have to agree on.
+    bool Connect(const std::string &address, int timeout, const std::vector<Real> &ladder);
+
+    // One tempering exchange at `step` for the local replicas. On rank 0, `sweep` gets the pressures and volumes
+    // of all replicas (in rank order) and updates the pressures in place. Returns false if a peer went away or
+    // sent something unexpected.
+    bool Exchange(int64_t step, std::vector<Real> &pressures, const std::vector<Real> &volumes,
+                  std::function<void(std::vector<Real>&, const std::vector<Real>&)> sweep);
+
+    // Replicas [first, last) of `n_replicas` that rank `rank` of `n_procs` hosts
+    static void GetRange(int n_replicas, int rank, int n_procs, int &first, int &last);
+
+    private:
+    struct Header
+    {
+        char magic[4];
+        uint32_t rank;
+        int64_t step;
+        uint32_t count;
+
+        // Zeroed first, padding included, since headers go over the wire as they are in memory
+        Header();
+        Header(const char magic[4], uint32_t rank, int64_t step, uint32_t count);
+    };
+
+    // Replicas in the whole run (set by Connect)
+    int n_replicas;
+
+    // Rank 0: one connection per other rank (indexed by rank, entry 0 unused). Other ranks: peers[0] is rank 0.
+    std::vector<int> peers;
+    int listener;
+    std::string unix_path;
+
+    bool Listen(const std::string &address);
+    int Dial(const std::string &address);
+    bool Send(int fd, const Header &header, const std::vector<float> &data);
+    bool Receive(int fd, const char magic[4], int64_t step, Header &header, std::vector<float> &data, uint32_t per_replica);
+};
@@ -1,77 +1,87 @@
+#include <limits>
 #include "Shape.h"
 
-Vector Shape::GetCOM()
+Shape::Shape(ParticleStore *store, uint index)
 {
-    Vector com(0,0,0);
-    for(unsigned int i=0;i<this->vertices.size();i++)
-        com += this->vertices[i];
-    com /= this->vertices.size();
-
-    return com;
+    this->store = store;
+    this->index = index;
 }
 
-Shape::~Shape()
+Vector Shape::GetCOM()
 {
+    return this->store->GetCOM(this->index);
 }
 
-// ========================================================================================================
-// Rotate - Rotate the particle in place (intrinsic) by translating to origin, applying rotation matrices
-//          then translating back
-// ========================================================================================================
-void Shape::Rotate(Matrix rot_matrix)
+Vector Shape::GetVertex(int k)
 {
-    Vector com = -1.0 * this->GetCOM();
-    this->Translate(com);
-
-    // Apply rotation
-    for(unsigned int i=0;i<this->vertices.size();i++)
-        this->vertices[i] = rot_matrix * this->vertices[i];
-
-    // Translate back
-    com *= -1;
-    this->Translate(com);
+    return this->store->GetVertex(this->index, k);
 }
 
-void Shape::Rotate(float roll, float pitch, float yaw)
+Vector Shape::GetVertexOffset(int k)
 {
-    Matrix r = Shape::GetRotationMatrix(roll, pitch, yaw);
-    this->Rotate(r);
+    return this->store->GetVertexOffset(this->index, k);
 }
 
-Matrix Shape::GetRotationMatrix(float roll, float pitch, float yaw)
+Shape::~Shape()
 {
-    // Compute rotation matrix
-    // *Note*: this bit was pulled verbatim from (http://stackoverflow.com/questions/21412169/creating-a-rotation-matrix-with-pitch-yaw-roll-using-eigen)
-    Eigen::AngleAxisd rollAngle(roll, Eigen::Vector3d::UnitZ());
-    Eigen::AngleAxisd yawAngle(yaw, Eigen::Vector3d::UnitY());
-    Eigen::AngleAxisd pitchAngle(pitch, Eigen::Vector3d::UnitX());
-
-    Eigen::Quaternion<double> q = rollAngle * yawAngle * pitchAngle;
-
-    return q.matrix();
 }
 
-
 // ========================================================================================================
 // ToString - Return a formatted string of this particle's coordinates (v1x, v1y, v1z, v2x, v2y, ... )
 // ========================================================================================================
 std::string Shape::ToString()
 {
-    std::string s = "";
-    for(unsigned int i=0;i<this->vertices.size();i++)
-    {
-        for(int j=0;j<3;j++)
-            s += std::to_string(this->vertices[i][j]) + " ";
-    }
-
-    return s;
+    return this->store->ToString(this->index);
 }
 
 // ========================================================================================================
-// Translate - Translate the particle 
+// SweptContact - The hull of a, translated by t*d, overlaps the hull of b iff t*d lies in the Minkowski difference
+//                b - a, the intersection of one slab per axis: min(b.n) - max(a.n) <= t d.n <= max(b.n) - min(a.n).
+//                Each slab bounds t from one or both sides; first contact is where the last slab is entered, 
+//                provided it comes before the first slab is left. Touching pairs moving apart never make contact
+//                (within round-off of the projections).
 // ========================================================================================================
-void Shape::Translate(Vector v)
+Real Shape::SweptContact(const Vector *a, int n_a, const Vector *b, int n_b, const Vector *axes, int n_axes, const Vector &d)
 {
-    for(uint i=0;i<this->vertices.size();i++)
-        this->vertices[i] += v;
+    const Real never = std::numeric_limits<Real>::max();
+    double t_enter = -std::numeric_limits<double>::max(), t_exit = std::numeric_limits<double>::max();
+
+    for(int k=0;k<n_axes;k++)
+    {
+        const Vector &n = axes[k];
+        double min_a, max_a, min_b, max_b;
+        min_a = max_a = n.dot(a[0]);
+        min_b = max_b = n.dot(b[0]);
+        for(int i=1;i<n_a;i++)
+        {
+            double p = n.dot(a[i]);
+            min_a = std::min(min_a, p); max_a = std::max(max_a, p);
+        }
+        for(int i=1;i<n_b;i++)
+        {
+            double p = n.dot(b[i]);
+            min_b = std::min(min_b, p); max_b = std::max(max_b, p);
+        }
+
+        double lo = min_b - max_a, hi = max_b - min_a;
+        double p = n.dot(d);
+        if (std::abs(p) < 1e-12*n.norm())
+        {
+            // Moving parallel to the slab: either always inside it or never
+            if (lo > 0 || hi < 0)
+                return never;
+            continue;
+        }
+
+        double t0 = lo/p, t1 = hi/p;
+        if (t0 > t1)
+            std::swap(t0, t1);
+        t_enter = std::max(t_enter, t0);
+        t_exit = std::min(t_exit, t1);
+
+        if (t_enter > t_exit || t_exit <= 1e-9)
+            return never;
+    }
+
+    return std::max(0.0, t_enter);
 }
@@ -3,31 +3,49 @@
 #pragma once
 #include <vector>
 #include "Globals.h"
+#include "ParticleStore.h"
 
+// A Shape is a lightweight handle on particle `index` of a ParticleStore - the store owns the state, the derived
+// classes (Sphere/Tetrahedron) supply the geometry and the narrow phase. Handles are cheap to build on the fly.
 class Shape
 {
-    private:
-    void Rotate(Matrix rot_matrix);
-
     public:
-    std::vector<Vector> vertices;
-    std::vector<Shape*> periodic_images;
+    ParticleStore *store;
+    uint index;
+
+    // Constructor
+    Shape(ParticleStore *store, uint index);
 
     // Member methods
     Vector GetCOM();
-    static Matrix GetRotationMatrix(float roll, float pitch, float yaw);
-
-    virtual void Rotate(float roll, float pitch, float yaw);
-    virtual void Translate(Vector v);
+    Vector GetVertex(int k);
+    // Vertex `k` relative to the COM (cheaper than GetVertex, which has to place the COM in the cell first)
+    Vector GetVertexOffset(int k);
 
-    void UpdatePeriodicImages();
     std::string ToString();
 
     // Virtual destructor
     virtual ~Shape();
 
     // Abstract methods to be implemented in Sphere/Tetrahedron
-    virtual bool Intersects(Shape *s) = 0;
     virtual Real GetVolume() = 0;
+
+    // Ray cast for polytopes: how far the hull of the points a[0..n_a) can be translated along the unit vector `d`
+    // before it touches the hull of b[0..n_b) (std::numeric_limits<Real>::max() if never, 0 if they already overlap).
+    // `axes` must include every face normal of the Minkowski difference b - a: the face normals of both bodies and
+    // the cross products of their edges.
+    static Real SweptContact(const Vector *a, int n_a, const Vector *b, int n_b, const Vector *axes, int n_axes, const Vector &d);
+
+    // Each shape also provides (non-virtual, so MCDriver<ShapeType> calls them directly):
+    //   bool Intersects(ShapeType *s, const Vector &offset)  - overlap test against s translated by `offset`
+    //                                                          (periodic images are never stored, `offset` is a 
+    //                                                          lattice vector h * [j,k,l] added on the fly)
+    //   Real Clearance(ShapeType *s, const Vector &offset)   - lower bound on the gap between the two
+    //   Real ContactDistance(ShapeType *s, const Vector &offset, const Vector &d)
+    //                                                        - distance we can move along the unit vector d before 
+    //                                                          touching s translated by `offset` (event chains)
+    //   typedef ... Batch                                    - batched narrow phase (see CollisionDetectedWith)
+    //   static std::vector<Vector> GetBodyVertices()         - body frame vertices for the ParticleStore
+    //   static Real GetCircumradius()                        - bounding sphere radius (broad phase range)
 };
 #endif // _SHAPE_H
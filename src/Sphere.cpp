@@ -1,8 +1,13 @@
+#include <limits>
 #include "Sphere.h"
 
-Sphere::Sphere(Vector v)
+Sphere::Sphere(ParticleStore *store, uint index): Shape(store, index)
 {
-    this->vertices.push_back(v);
+}
+
+std::vector<Vector> Sphere::GetBodyVertices()
+{
+    return std::vector<Vector>(1, Vector(0,0,0));
 }
 
 Real Sphere::GetVolume()
@@ -11,10 +16,60 @@ Real Sphere::GetVolume()
     return 4./3. * PI * r3;
 }
 
-bool Sphere::Intersects(Shape *s2)
+Real Sphere::GetCircumradius()
+{
+    return 0.5;
+}
+
+bool Sphere::Intersects(Sphere *s2, const Vector &offset)
+{
+    // Overlap when the centers are closer than a diameter
+    return (this->GetCOM() - s2->GetCOM() - offset).squaredNorm() < 1;
+}
+
+Real Sphere::Clearance(Sphere *s2, const Vector &offset)
+{
+    return (s2->GetCOM() + offset - this->GetCOM()).norm() - 1;
+}
+
+// Smallest t >= 0 with |r - t d| = 1 (r: center to center), i.e. t^2 - 2 t r.d + |r|^2 - 1 = 0
+Real Sphere::ContactDistance(Sphere *s2, const Vector &offset, const Vector &d)
+{
+    Vector r = s2->GetCOM() + offset - this->GetCOM();
+    double b = r.dot(d);
+    double disc = b*b - (r.squaredNorm() - 1);
+
+    // Moving away from (or past) the other sphere
+    if (b <= 0 || disc < 0)
+        return std::numeric_limits<Real>::max();
+
+    return std::max(0.0, b - sqrt(disc));
+}
+
+SphereBatch::SphereBatch(const Sphere &s)
+{
+    this->store = s.store;
+    this->origin = this->store->GetCOM(s.index);
+    this->size = 0;
+}
+
+bool SphereBatch::Add(uint j, const Vector &offset)
+{
+    Vector dr = this->store->GetCOM(j) + offset - this->origin;
+    this->x[this->size] = dr[0];
+    this->y[this->size] = dr[1];
+    this->z[this->size] = dr[2];
+    this->size++;
+
+    return this->size == SphereBatch::WIDTH;
+}
+
+bool SphereBatch::Flush()
 {
-    if (sqrt((this->GetCOM() - s2->GetCOM()).norm()) < 1)
-        return true;
+    bool hit = false;
+    for(int c=0;c<this->size;c++)
+        hit |= (this->x[c]*this->x[c] + this->y[c]*this->y[c] + this->z[c]*this->z[c] < 1);
 
-    return false;
+    this->size = 0;
+    return hit;
 }
@@ -3,13 +3,51 @@
 #include "Globals.h"
 #include "Shape.h"
 
+class SphereBatch;
+
 class Sphere: public Shape
 {
     public:
-    // Constructor
-    Sphere(Vector origin);
+    // Candidate container used by the batched narrow phase in MCDriver::CollisionDetectedWith
+    typedef SphereBatch Batch;
+
+    // Constructor - handle on particle `index` of `store`
+    Sphere(ParticleStore *store, uint index);
 
-    // Implement sphere-sphere intersection
-    bool Intersects(Shape *t2);
+    // Implement sphere-sphere intersection (against t2 translated by `offset`)
+    bool Intersects(Sphere *s2, const Vector &offset);
     Real GetVolume();
+
+    // Distance between the surfaces of the two spheres (negative if they overlap)
+    Real Clearance(Sphere *s2, const Vector &offset);
+
+    // Distance we can move along the unit vector `d` before touching s2 translated by `offset`
+    Real ContactDistance(Sphere *s2, const Vector &offset, const Vector &d);
+
+    // A sphere is stored as its center: a single body-frame vertex at the COM
+    static std::vector<Vector> GetBodyVertices();
+
+    // Radius of the bounding sphere (sets the range of the broad phase)
+    static Real GetCircumradius();
+};
+
+// Up to WIDTH candidate spheres (centers relative to the tested sphere, structure-of-arrays) tested in one pass
+class SphereBatch
+{
+    public:
+    static const int WIDTH = 8;
+
+    float x[WIDTH], y[WIDTH], z[WIDTH];
+    int size;
+    ParticleStore *store;
+    Vector origin;
+
+    SphereBatch(const Sphere &s);
+
+    // Queue particle `j` of the tested sphere's store translated by `offset`. Returns true once the batch is full 
+    // and should be flushed.
+    bool Add(uint j, const Vector &offset);
+
+    // Test all queued candidates and empty the batch. Returns true if any of them overlaps.
+    bool Flush();
 };
@@ -0,0 +1,53 @@
+#include <sstream>
+#include "Stats.h"
+
+static const char *COUNTER_NAMES[MCStats::N_COUNTERS] =
+{
+    "translations", "translations_accepted", "rotations", "rotations_accepted",
+    "cell_moves", "cell_moves_accepted", "cell_moves_prescreened",
+    "broad_phase_candidates", "narrow_phase_calls", "cell_move_checked", "cell_move_skipped",
+    "event_chains", "chain_contacts", "domain_rejections"
+};
+
+static const char *PHASE_NAMES[MCStats::N_PHASES] =
+{
+    "particle_apply", "wrap", "collision", "cell_apply", "cell_collision", "cell_update", "event_chain"
+};
+
+MCStats::MCStats()
+{
+    this->Reset();
+}
+
+void MCStats::Reset()
+{
+    for(int k=0;k<N_COUNTERS;k++)
+        this->counts[k] = 0;
+    for(int k=0;k<N_PHASES;k++)
+        this->seconds[k] = 0;
+}
+
+void MCStats::Merge(const MCStats &other)
+{
+    for(int k=0;k<N_COUNTERS;k++)
+        this->counts[k] += other.counts[k];
+    for(int k=0;k<N_PHASES;k++)
+        this->seconds[k] += other.seconds[k];
+}
+
+std::string MCStats::ToJSON()
+{
+    std::ostringstream out;
+
+    out << "{\"counts\": {";
+    for(int k=0;k<N_COUNTERS;k++)
+        out << "\"" << COUNTER_NAMES[k] << "\": " << this->counts[k] << ", ";
+    out << "\"bounding_sphere_early_outs\": " << this->counts[BROAD_CANDIDATES] - this->counts[NARROW_CALLS] << "}, ";
+
+    out << "\"seconds\": {";
+    for(int k=0;k<N_PHASES;k++)
+        out << (k > 0 ? ", " : "") << "\"" << PHASE_NAMES[k] << "\": " << this->seconds[k];
+    out << "}}";
+
+    return out.str();
+}
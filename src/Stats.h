@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include "Globals.h"
+
+// ========================================================================================================
+// MCStats - Hot path counters and phase timers of one MCDriver. No atomics: a driver's own MCStats is only
+//           touched by the thread running it, and the domain tasks of a checkerboard sweep count into MCStats
+//           of their own that are merged afterwards (see MCDriver::MakeSweep). They are only collected in
+//           builds with MC_STATS defined (`make STATS=1`); otherwise the STATS_* macros compile to nothing.
+//
+// BROAD_CANDIDATES counts every particle/image the broad phase hands to the narrow phase batch, NARROW_CALLS
+// the ones that were actually queued for the overlap kernel - the rest were dropped by the bounding sphere
+// test (reported as bounding_sphere_early_outs). CELL_CHECKED/CELL_SKIPPED count the particles that did or
+// didn't need a narrow phase after a cell move (see MCDriver::CollisionDetectedAfterStrain). CHAIN_CONTACTS
+// counts the times an event chain was passed on to the particle it hit, DOMAIN_REJECTIONS the particle moves of
+// a checkerboard sweep that were rejected for leaving their domain (see MCDriver::MakeMoves).
+// ========================================================================================================
+class MCStats
+{
+    public:
+#ifdef MC_STATS
+    static const bool ENABLED = true;
+#else
+    static const bool ENABLED = false;
+#endif
+
+    enum Counter
+    {
+        TRANSLATIONS, TRANSLATIONS_ACCEPTED, ROTATIONS, ROTATIONS_ACCEPTED,
+        CELL_MOVES, CELL_MOVES_ACCEPTED, CELL_MOVES_PRESCREENED,
+        BROAD_CANDIDATES, NARROW_CALLS, CELL_CHECKED, CELL_SKIPPED,
+        EVENT_CHAINS, CHAIN_CONTACTS, DOMAIN_REJECTIONS,
+        N_COUNTERS
+    };
+
+    // PARTICLE_APPLY/CELL_APPLY: generating the trial move, WRAP: Cell::WrapShape of the moved particle,
+    // COLLISION/CELL_COLLISION: overlap checks after a particle/cell move, CELL_UPDATE: cell list and
+    // clearance bookkeeping after an accepted cell move, EVENT_CHAIN: whole event chains
+    enum Phase
+    {
+        PARTICLE_APPLY, WRAP, COLLISION, CELL_APPLY, CELL_COLLISION, CELL_UPDATE, EVENT_CHAIN,
+        N_PHASES
+    };
+
+    uint64_t counts[N_COUNTERS];
+    double seconds[N_PHASES];
+
+    MCStats();
+    void Reset();
+    // Add the counts and times of `other` (e.g. of the domains of a checkerboard sweep)
+    void Merge(const MCStats &other);
+
+    // One JSON object (no trailing newline)
+    std::string ToJSON();
+
+    // Adds the lifetime of the timer to `phase`
+    class Timer
+    {
+        public:
+        Timer(MCStats *stats, Phase phase);
+        ~Timer();
+
+        private:
+        MCStats *stats;
+        Phase phase;
+        std::chrono::steady_clock::time_point start;
+    };
+};
+
+#ifdef MC_STATS
+#define STATS_COUNT(stats, counter, n) ((stats).counts[MCStats::counter] += (n))
+#define STATS_TIMER(stats, phase) MCStats::Timer stats_timer_##phase(&(stats), MCStats::phase)
+#else
+#define STATS_COUNT(stats, counter, n) ((void)(stats))
+#define STATS_TIMER(stats, phase) ((void)(stats))
+#endif
+
+inline MCStats::Timer::Timer(MCStats *stats, Phase phase)
+{
+    this->stats = stats;
+    this->phase = phase;
+    this->start = std::chrono::steady_clock::now();
+}
+
+inline MCStats::Timer::~Timer()
+{
+    this->stats->seconds[this->phase] += std::chrono::duration<double>(std::chrono::steady_clock::now() - this->start).count();
+}
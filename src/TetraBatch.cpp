@@ -0,0 +1,291 @@
+#include <cfloat>
+#include "Tetrahedron.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_AVX2_KERNEL
+#endif
+
+static const int EDGES[6][2] = {{0,1}, {0,2}, {0,3}, {1,2}, {1,3}, {2,3}};
+static const int FACES[4][3] = {{0,1,2}, {0,1,3}, {0,2,3}, {1,2,3}};
+
+// Cross products shorter than this are treated as parallel edges (no usable axis)
+static const float PARALLEL_EPS = 1e-12f;
+
+// The vertices are rounded to float and each projection is off by a few ulps of |n||v|, which is within a small 
+// multiple of the projected extent of the pair (the tested particle's interval contains its own center, the origin).
+// An axis only separates if the gap beats this fraction of the extent, so round-off can't hide an overlap - touching 
+// pairs and gaps of a few ulps count as overlapping.
+static const float SEPARATION_EPS = 8*FLT_EPSILON;
+
+#ifdef HAVE_AVX2_KERNEL
+bool TetraBatch::use_avx2 = __builtin_cpu_supports("avx2");
+#else
+bool TetraBatch::use_avx2 = false;
+#endif
+
+TetraBatch::TetraBatch(const Tetrahedron &t): t(t)
+{
+    this->origin = this->t.GetCOM();
+    this->size = 0;
+
+    // Unused lanes are masked out, but keep them as well-defined numbers
+    for(int v=0;v<4;v++)
+        for(int c=0;c<TetraBatch::WIDTH;c++)
+            this->x[v][c] = this->y[v][c] = this->z[v][c] = 0;
+}
+
+bool TetraBatch::Add(uint j, const Vector &offset)
+{
+    ParticleStore *store = this->t.store;
+    Vector dr = store->GetCOM(j) + offset - this->origin;
+
+    // Bounding sphere early-out, same as Tetrahedron::Intersects
+    if (dr.norm() > 2*Tetrahedron::GetCircumradius())
+        return false;
+
+    int lane = this->size++;
+    for(int v=0;v<4;v++)
+    {
+        Vector r = dr + store->GetVertexOffset(j, v);
+        this->x[v][lane] = r[0];
+        this->y[v][lane] = r[1];
+        this->z[v][lane] = r[2];
+    }
+    this->candidates[lane] = j;
+    this->offsets[lane] = offset;
+
+    return this->size == TetraBatch::WIDTH;
+}
+
+bool TetraBatch::Flush()
+{
+    bool hit = false;
+
+    if (this->size > 0)
+    {
+        if (Tetrahedron::overlap_kernel == Tetrahedron::SAT)
+            hit = this->t.IntersectsAny(*this);
+        else
+            for(int c=0;c<this->size && !hit;c++)
+            {
+                Tetrahedron candidate(this->t.store, this->candidates[c]);
+                hit = this->t.IntersectsTriangles(&candidate, this->offsets[c]);
+            }
+    }
+
+    this->size = 0;
+    return hit;
+}
+
+// ========================================================================================================
+// Scalar kernel - separating axis test of tetrahedron `a` against the candidates in `b`, one lane at a time 
+//                 (so each lane can exit on its first separating axis). Uses exactly the single precision 
+//                 arithmetic of the AVX2 kernel below, so both give the same answer for every lane.
+// ========================================================================================================
+
+// Project a and lane c of b onto (nx, ny, nz) and return whether the intervals are disjoint
+static inline bool SeparatesLane(const float a[4][3], const TetraBatch &b, int c, float nx, float ny, float nz)
+{
+    float min_a, max_a, min_b, max_b;
+    min_a = max_a = nx*a[0][0] + ny*a[0][1] + nz*a[0][2];
+    min_b = max_b = nx*b.x[0][c] + ny*b.y[0][c] + nz*b.z[0][c];
+    for(int v=1;v<4;v++)
+    {
+        float pa = nx*a[v][0] + ny*a[v][1] + nz*a[v][2];
+        float pb = nx*b.x[v][c] + ny*b.y[v][c] + nz*b.z[v][c];
+        min_a = std::min(min_a, pa); max_a = std::max(max_a, pa);
+        min_b = std::min(min_b, pb); max_b = std::max(max_b, pb);
+    }
+
+    float tol = SEPARATION_EPS*(std::max(max_a, max_b) - std::min(min_a, min_b));
+    return max_a + tol < min_b || max_b + tol < min_a;
+}
+
+static bool LaneSeparated(const float a[4][3], const TetraBatch &b, int c)
+{
+    // Face normals of a
+    for(int f=0;f<4;f++)
+    {
+        const int *v = FACES[f];
+        float e1[3], e2[3];
+        for(int k=0;k<3;k++) { e1[k] = a[v[1]][k] - a[v[0]][k]; e2[k] = a[v[2]][k] - a[v[0]][k]; }
+
+        if (SeparatesLane(a, b, c, e1[1]*e2[2] - e1[2]*e2[1], e1[2]*e2[0] - e1[0]*e2[2], e1[0]*e2[1] - e1[1]*e2[0]))
+            return true;
+    }
+
+    // Face normals of the candidate
+    for(int f=0;f<4;f++)
+    {
+        const int *v = FACES[f];
+        float e1x = b.x[v[1]][c] - b.x[v[0]][c], e1y = b.y[v[1]][c] - b.y[v[0]][c], e1z = b.z[v[1]][c] - b.z[v[0]][c];
+        float e2x = b.x[v[2]][c] - b.x[v[0]][c], e2y = b.y[v[2]][c] - b.y[v[0]][c], e2z = b.z[v[2]][c] - b.z[v[0]][c];
+
+        if (SeparatesLane(a, b, c, e1y*e2z - e1z*e2y, e1z*e2x - e1x*e2z, e1x*e2y - e1y*e2x))
+            return true;
+    }
+
+    // Edge-edge cross products
+    for(int i=0;i<6;i++)
+    {
+        float ea[3];
+        for(int k=0;k<3;k++)
+            ea[k] = a[EDGES[i][1]][k] - a[EDGES[i][0]][k];
+
+        for(int j=0;j<6;j++)
+        {
+            const int v0 = EDGES[j][0], v1 = EDGES[j][1];
+            float ebx = b.x[v1][c] - b.x[v0][c], eby = b.y[v1][c] - b.y[v0][c], ebz = b.z[v1][c] - b.z[v0][c];
+            float nx = ea[1]*ebz - ea[2]*eby;
+            float ny = ea[2]*ebx - ea[0]*ebz;
+            float nz = ea[0]*eby - ea[1]*ebx;
+
+            // Parallel edges give no usable axis
+            if (nx*nx + ny*ny + nz*nz < PARALLEL_EPS)
+                continue;
+
+            if (SeparatesLane(a, b, c, nx, ny, nz))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+static bool OverlapsAnyScalar(const float a[4][3], const TetraBatch &b)
+{
+    for(int c=0;c<b.size;c++)
+        if (!LaneSeparated(a, b, c))
+            return true;
+
+    return false;
+}
+
+#ifdef HAVE_AVX2_KERNEL
+// ========================================================================================================
+// AVX2 kernel - same algorithm as OverlapsAnyScalar with the 8 candidates in the lanes of one register
+// ========================================================================================================
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+// Project a (broadcast) and the candidates onto the per-lane axis (nx, ny, nz); return the lanes it separates
+static inline AVX2_TARGET __m256 SeparatingLanes(const float a[4][3], const TetraBatch &b, __m256 nx, __m256 ny, __m256 nz)
+{
+    __m256 min_a, max_a, min_b, max_b;
+    for(int v=0;v<4;v++)
+    {
+        __m256 pa = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, _mm256_set1_ps(a[v][0])),
+                                                _mm256_mul_ps(ny, _mm256_set1_ps(a[v][1]))),
+                                                _mm256_mul_ps(nz, _mm256_set1_ps(a[v][2])));
+        __m256 pb = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, _mm256_load_ps(b.x[v])),
+                                                _mm256_mul_ps(ny, _mm256_load_ps(b.y[v]))),
+                                                _mm256_mul_ps(nz, _mm256_load_ps(b.z[v])));
+        if (v == 0) { min_a = max_a = pa; min_b = max_b = pb; continue; }
+        min_a = _mm256_min_ps(min_a, pa); max_a = _mm256_max_ps(max_a, pa);
+        min_b = _mm256_min_ps(min_b, pb); max_b = _mm256_max_ps(max_b, pb);
+    }
+
+    // Same operations in the same order as SeparatesLane
+    __m256 tol = _mm256_mul_ps(_mm256_set1_ps(SEPARATION_EPS), _mm256_sub_ps(_mm256_max_ps(max_a, max_b), _mm256_min_ps(min_a, min_b)));
+    return _mm256_or_ps(_mm256_cmp_ps(_mm256_add_ps(max_a, tol), min_b, _CMP_LT_OQ), 
+                        _mm256_cmp_ps(_mm256_add_ps(max_b, tol), min_a, _CMP_LT_OQ));
+}
+
+static inline AVX2_TARGET void Cross(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz, __m256 &nx, __m256 &ny, __m256 &nz)
+{
+    nx = _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(az, by));
+    ny = _mm256_sub_ps(_mm256_mul_ps(az, bx), _mm256_mul_ps(ax, bz));
+    nz = _mm256_sub_ps(_mm256_mul_ps(ax, by), _mm256_mul_ps(ay, bx));
+}
+
+static AVX2_TARGET bool OverlapsAnyAVX2(const float a[4][3], const TetraBatch &b)
+{
+    // Lanes past the end of the batch start out separated
+    const int all = (1 << TetraBatch::WIDTH) - 1;
+    int separated = all & ~((1 << b.size) - 1);
+
+    // Face normals of a (shared by every lane)
+    for(int f=0;f<4;f++)
+    {
+        const int *v = FACES[f];
+        float e1[3], e2[3];
+        for(int k=0;k<3;k++) { e1[k] = a[v[1]][k] - a[v[0]][k]; e2[k] = a[v[2]][k] - a[v[0]][k]; }
+
+        __m256 nx = _mm256_set1_ps(e1[1]*e2[2] - e1[2]*e2[1]);
+        __m256 ny = _mm256_set1_ps(e1[2]*e2[0] - e1[0]*e2[2]);
+        __m256 nz = _mm256_set1_ps(e1[0]*e2[1] - e1[1]*e2[0]);
+
+        separated |= _mm256_movemask_ps(SeparatingLanes(a, b, nx, ny, nz));
+        if (separated == all)
+            return false;
+    }
+
+    // Face normals of each candidate
+    for(int f=0;f<4;f++)
+    {
+        const int *v = FACES[f];
+        __m256 x0 = _mm256_load_ps(b.x[v[0]]), y0 = _mm256_load_ps(b.y[v[0]]), z0 = _mm256_load_ps(b.z[v[0]]);
+        __m256 e1x = _mm256_sub_ps(_mm256_load_ps(b.x[v[1]]), x0), e1y = _mm256_sub_ps(_mm256_load_ps(b.y[v[1]]), y0), e1z = _mm256_sub_ps(_mm256_load_ps(b.z[v[1]]), z0);
+        __m256 e2x = _mm256_sub_ps(_mm256_load_ps(b.x[v[2]]), x0), e2y = _mm256_sub_ps(_mm256_load_ps(b.y[v[2]]), y0), e2z = _mm256_sub_ps(_mm256_load_ps(b.z[v[2]]), z0);
+
+        __m256 nx, ny, nz;
+        Cross(e1x, e1y, e1z, e2x, e2y, e2z, nx, ny, nz);
+
+        separated |= _mm256_movemask_ps(SeparatingLanes(a, b, nx, ny, nz));
+        if (separated == all)
+            return false;
+    }
+
+    // Edge-edge cross products
+    const __m256 eps = _mm256_set1_ps(PARALLEL_EPS);
+    for(int i=0;i<6;i++)
+    {
+        __m256 eax = _mm256_set1_ps(a[EDGES[i][1]][0] - a[EDGES[i][0]][0]);
+        __m256 eay = _mm256_set1_ps(a[EDGES[i][1]][1] - a[EDGES[i][0]][1]);
+        __m256 eaz = _mm256_set1_ps(a[EDGES[i][1]][2] - a[EDGES[i][0]][2]);
+
+        for(int j=0;j<6;j++)
+        {
+            const int v0 = EDGES[j][0], v1 = EDGES[j][1];
+            __m256 ebx = _mm256_sub_ps(_mm256_load_ps(b.x[v1]), _mm256_load_ps(b.x[v0]));
+            __m256 eby = _mm256_sub_ps(_mm256_load_ps(b.y[v1]), _mm256_load_ps(b.y[v0]));
+            __m256 ebz = _mm256_sub_ps(_mm256_load_ps(b.z[v1]), _mm256_load_ps(b.z[v0]));
+
+            __m256 nx, ny, nz;
+            Cross(eax, eay, eaz, ebx, eby, ebz, nx, ny, nz);
+
+            // Ignore lanes whose edges are parallel
+            __m256 len2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz));
+            __m256 usable = _mm256_cmp_ps(len2, eps, _CMP_GE_OQ);
+
+            separated |= _mm256_movemask_ps(_mm256_and_ps(usable, SeparatingLanes(a, b, nx, ny, nz)));
+            if (separated == all)
+                return false;
+        }
+    }
+
+    return true;
+}
+#endif
+
+// ========================================================================================================
+// IntersectsAny - Returns `true` if this tetrahedron overlaps any of the candidates queued in `batch`
+// ========================================================================================================
+bool Tetrahedron::IntersectsAny(const TetraBatch &batch)
+{
+    float a[4][3];
+    Vector com = this->GetCOM() - batch.origin;
+    for(int v=0;v<4;v++)
+    {
+        Vector r = com + this->GetVertexOffset(v);
+        for(int k=0;k<3;k++)
+            a[v][k] = r[k];
+    }
+
+#ifdef HAVE_AVX2_KERNEL
+    if (TetraBatch::use_avx2)
+        return OverlapsAnyAVX2(a, batch);
+#endif
+
+    return OverlapsAnyScalar(a, batch);
+}
@@ -1,70 +1,218 @@
+#include <limits>
 #include "Tetrahedron.h"
 #include "Collision.h"
 
+Tetrahedron::OverlapKernel Tetrahedron::overlap_kernel = Tetrahedron::SAT;
+
+// Vertex index pairs for the 6 edges, and vertex index triples for the 4 faces, of a tetrahedron
+static const int EDGES[6][2] = {{0,1}, {0,2}, {0,3}, {1,2}, {1,3}, {2,3}};
+static const int FACES[4][3] = {{0,1,2}, {0,1,3}, {0,2,3}, {1,2,3}};
+
+// Constructor - handle on particle `index` of `store`
+Tetrahedron::Tetrahedron(ParticleStore *store, uint index): Shape(store, index)
+{
+}
+
 // ========================================================================================================
-// Constructor - build a new Tetrahedron instance from a point (the COM) + 3D rotation
+// Intersects - Returns `true` if the two Tetrahedra (`this` and `t2` translated by `offset`) are intersecting, 
+//              `false` otherwise
 // ========================================================================================================
-Tetrahedron::Tetrahedron(Vector origin, float roll, float pitch, float yaw): Shape()
+bool Tetrahedron::Intersects(Tetrahedron *t2, const Vector &offset)
 {
-    //Start from a standard Tetrahedron centered at (0,0,0), then apply the origin translation and rotation
-    vertices.push_back(Vector(0.5, 0, -0.5/sqrt(2.0)));
-    vertices.push_back(Vector(-0.5, 0, -0.5/sqrt(2.0)));
-    vertices.push_back(Vector(0, 0.5, 0.5/sqrt(2.0)));
-    vertices.push_back(Vector(0, -0.5, 0.5/sqrt(2.0)));
+    // If the centers of mass of the two tetrahedra are further than the diameter of the sphere that circumscribes a regular tetrahedron, then no collision is possible
+    if ((this->GetCOM() - t2->GetCOM() - offset).norm() > 2*Tetrahedron::GetCircumradius())
+        return false;
 
-    // Initialize the 4-triangle representation of this tetrahedron for collision detection
-    this->triangles.push_back(new Triangle(this->vertices[0], this->vertices[1], this->vertices[2]));
-    this->triangles.push_back(new Triangle(this->vertices[0], this->vertices[1], this->vertices[3]));
-    this->triangles.push_back(new Triangle(this->vertices[0], this->vertices[2], this->vertices[3]));
-    this->triangles.push_back(new Triangle(this->vertices[1], this->vertices[2], this->vertices[3]));
+    if (Tetrahedron::overlap_kernel == Tetrahedron::SAT)
+        return this->IntersectsSAT(t2, offset);
 
-    this->Translate(origin);
-    this->Rotate(roll, pitch, yaw);
+    return this->IntersectsTriangles(t2, offset);
 }
 
-// Copy constructor
-Tetrahedron::Tetrahedron(Tetrahedron &t)
+// ========================================================================================================
+// IntersectsSAT - Separating axis test. Two convex polyhedra are disjoint iff their projections are disjoint 
+//                 on at least one of: the face normals of either (4+4) or the cross products of an edge of 
+//                 each (6x6). Unlike the triangle tests, this also catches one tetrahedron inside the other.
+// ========================================================================================================
+bool Tetrahedron::IntersectsSAT(Tetrahedron *t2, const Vector &offset)
 {
-    // Copy the vertices
-    for(uint i=0;i<t.vertices.size();i++)
-        vertices.push_back(t.vertices[i]);
-
-    // Initialize the 4-triangle representation of this tetrahedron for collision detection
-    this->triangles.push_back(new Triangle(this->vertices[0], this->vertices[1], this->vertices[2]));
-    this->triangles.push_back(new Triangle(this->vertices[0], this->vertices[1], this->vertices[3]));
-    this->triangles.push_back(new Triangle(this->vertices[0], this->vertices[2], this->vertices[3]));
-    this->triangles.push_back(new Triangle(this->vertices[1], this->vertices[2], this->vertices[3]));
+    // Work relative to our first vertex to keep the projections well conditioned
+    Vector r = t2->GetCOM() + offset - this->GetCOM() - this->GetVertexOffset(0);
+    Vector a[4], b[4];
+    for(int i=0;i<4;i++)
+    {
+        a[i] = this->GetVertexOffset(i) - this->GetVertexOffset(0);
+        b[i] = r + t2->GetVertexOffset(i);
+    }
+
+    // Returns true if `axis` separates the two vertex sets
+    auto separates = [&](const Vector &axis) -> bool
+    {
+        double min_a, max_a, min_b, max_b;
+        min_a = max_a = axis.dot(a[0]);
+        min_b = max_b = axis.dot(b[0]);
+        for(int i=1;i<4;i++)
+        {
+            double pa = axis.dot(a[i]);
+            double pb = axis.dot(b[i]);
+            min_a = std::min(min_a, pa); max_a = std::max(max_a, pa);
+            min_b = std::min(min_b, pb); max_b = std::max(max_b, pb);
+        }
+
+        return max_a < min_b || max_b < min_a;
+    };
+
+    // Face normals
+    for(int f=0;f<4;f++)
+    {
+        const int *v = FACES[f];
+        if (separates((a[v[1]] - a[v[0]]).cross(a[v[2]] - a[v[0]])))
+            return false;
+        if (separates((b[v[1]] - b[v[0]]).cross(b[v[2]] - b[v[0]])))
+            return false;
+    }
+
+    // Edge-edge cross products
+    Vector edges_a[6], edges_b[6];
+    for(int e=0;e<6;e++)
+    {
+        edges_a[e] = a[EDGES[e][1]] - a[EDGES[e][0]];
+        edges_b[e] = b[EDGES[e][1]] - b[EDGES[e][0]];
+    }
+
+    for(int i=0;i<6;i++)
+    for(int j=0;j<6;j++)
+    {
+        Vector axis = edges_a[i].cross(edges_b[j]);
+
+        // Parallel edges give no new axis (that case is covered by the face normals)
+        if (axis.squaredNorm() < 1e-12)
+            continue;
+
+        if (separates(axis))
+            return false;
+    }
+
+    return true;
 }
-Tetrahedron::~Tetrahedron()
+
+// ========================================================================================================
+// Clearance - Cheap lower bound on the distance between `this` and `t2` translated by `offset` (<= 0 if they 
+//             may overlap). Uses the bounding spheres and the gap between the projections onto the center-center
+//             axis and the 4+4 face normals - any such gap is a lower bound on the true distance.
+// ========================================================================================================
+Real Tetrahedron::Clearance(Tetrahedron *t2, const Vector &offset)
 {
-    for(uint i=0;i<this->triangles.size();i++)
-        delete this->triangles[i];
+    Vector com = this->GetCOM();
+    Vector r = t2->GetCOM() + offset - com;
+    double best = r.norm() - 2*Tetrahedron::GetCircumradius();
+
+    Vector a[4], b[4];
+    for(int i=0;i<4;i++)
+    {
+        a[i] = this->GetVertexOffset(i);
+        b[i] = r + t2->GetVertexOffset(i);
+    }
+
+    auto gap = [&](Vector axis)
+    {
+        axis.normalize();
+
+        double min_a, max_a, min_b, max_b;
+        min_a = max_a = axis.dot(a[0]);
+        min_b = max_b = axis.dot(b[0]);
+        for(int i=1;i<4;i++)
+        {
+            double pa = axis.dot(a[i]);
+            double pb = axis.dot(b[i]);
+            min_a = std::min(min_a, pa); max_a = std::max(max_a, pa);
+            min_b = std::min(min_b, pb); max_b = std::max(max_b, pb);
+        }
+
+        best = std::max(best, std::max(min_b - max_a, min_a - max_b));
+    };
+
+    if (r.squaredNorm() > 0)
+        gap(r);
+
+    for(int f=0;f<4;f++)
+    {
+        const int *v = FACES[f];
+        gap((a[v[1]] - a[v[0]]).cross(a[v[2]] - a[v[0]]));
+        gap((b[v[1]] - b[v[0]]).cross(b[v[2]] - b[v[0]]));
+    }
+
+    return best;
 }
 
 // ========================================================================================================
-// Intersects - Returns `true` if the two Tetrahedra (`this` and `t2`) are intersecting, `false` otherwise
+// ContactDistance - Ray cast version of the SAT kernel: the same 4+4 face normals and 6x6 edge cross products
+//                   are the face normals of the Minkowski difference, so Shape::SweptContact is exact here
 // ========================================================================================================
-bool Tetrahedron::Intersects(Shape *shape)
+Real Tetrahedron::ContactDistance(Tetrahedron *t2, const Vector &offset, const Vector &d)
 {
-    // This only works for tetrahedra, so just reinterpret_cast here
-    Tetrahedron *t2 = reinterpret_cast<Tetrahedron*>(shape);
+    Vector com = this->GetCOM();
 
-    // If the centers of mass of the two tetrahedra are further than the diameter of the sphere that circumscribes a regular tetrahedron, then no collision is possible
-    if ((this->GetCOM() - t2->GetCOM()).norm() > sqrt(6.)/2.0)
-        return false;
+    // The bounding spheres have to meet first: the ray has to pass within 2R of the other center
+    Vector r = t2->GetCOM() + offset - com;
+    double along = r.dot(d), R2 = 4*Tetrahedron::GetCircumradius()*Tetrahedron::GetCircumradius();
+    if (r.squaredNorm() - along*along > R2 || (along < 0 && r.squaredNorm() > R2))
+        return std::numeric_limits<Real>::max();
 
-    // Check each pair of triangles making up the two tetrahedra and check if they're intersecting
+    Vector a[4], b[4];
+    for(int i=0;i<4;i++)
+    {
+        a[i] = this->GetVertexOffset(i);
+        b[i] = r + t2->GetVertexOffset(i);
+    }
+
+    Vector axes[4 + 4 + 6*6];
+    int n_axes = 0;
+    for(int f=0;f<4;f++)
+    {
+        const int *v = FACES[f];
+        axes[n_axes++] = (a[v[1]] - a[v[0]]).cross(a[v[2]] - a[v[0]]);
+        axes[n_axes++] = (b[v[1]] - b[v[0]]).cross(b[v[2]] - b[v[0]]);
+    }
+
+    for(int i=0;i<6;i++)
+    for(int j=0;j<6;j++)
+    {
+        Vector axis = (a[EDGES[i][1]] - a[EDGES[i][0]]).cross(b[EDGES[j][1]] - b[EDGES[j][0]]);
+        if (axis.squaredNorm() >= 1e-12)
+            axes[n_axes++] = axis;
+    }
+
+    return Shape::SweptContact(a, 4, b, 4, axes, n_axes, d);
+}
+
+// ========================================================================================================
+// IntersectsTriangles - Original kernel: test all 4x4 face pairs with tr_tri_intersect3D (misses containment)
+// ========================================================================================================
+bool Tetrahedron::IntersectsTriangles(Tetrahedron *t2, const Vector &offset)
+{
+    Vector a[4], b[4];
     for(int i=0;i<4;i++)
+    {
+        a[i] = this->GetVertex(i);
+        b[i] = t2->GetVertex(i) + offset;
+    }
+
+    // Check each pair of triangles making up the two tetrahedra and check if they're intersecting
     for(int j=0;j<4;j++)
     {
-        Triangle *tri_1 = this->triangles[i];
-        Triangle *tri_2 = t2->triangles[j];
+        Triangle tri_2(b[FACES[j][0]], b[FACES[j][1]], b[FACES[j][2]]);
 
-        // If these two triangles intersect, then return true for collision
-        if(tr_tri_intersect3D(tri_1->vertex, tri_1->edge1, tri_1->edge2,
-                              tri_2->vertex, tri_2->edge1, tri_2->edge2) != 0)
+        for(int i=0;i<4;i++)
         {
-            return true;
+            Triangle tri_1(a[FACES[i][0]], a[FACES[i][1]], a[FACES[i][2]]);
+
+            // If these two triangles intersect, then return true for collision
+            if(tr_tri_intersect3D(tri_1.vertex, tri_1.edge1, tri_1.edge2,
+                                  tri_2.vertex, tri_2.edge1, tri_2.edge2) != 0)
+            {
+                return true;
+            }
         }
     }
         
@@ -77,22 +225,19 @@ Real Tetrahedron::GetVolume()
     return 1.0 / (6*sqrt(2.0));
 }
 
-void Tetrahedron::UpdateTriangles()
+std::vector<Vector> Tetrahedron::GetBodyVertices()
 {
-    this->triangles[0]->Update(this->vertices[0], this->vertices[1], this->vertices[2]);
-    this->triangles[1]->Update(this->vertices[0], this->vertices[1], this->vertices[3]);
-    this->triangles[2]->Update(this->vertices[0], this->vertices[2], this->vertices[3]);
-    this->triangles[3]->Update(this->vertices[1], this->vertices[2], this->vertices[3]);
-}
+    // Standard Tetrahedron centered at (0,0,0)
+    std::vector<Vector> vertices;
+    vertices.push_back(Vector(0.5, 0, -0.5/sqrt(2.0)));
+    vertices.push_back(Vector(-0.5, 0, -0.5/sqrt(2.0)));
+    vertices.push_back(Vector(0, 0.5, 0.5/sqrt(2.0)));
+    vertices.push_back(Vector(0, -0.5, 0.5/sqrt(2.0)));
 
-// Intercept all Rotate/Translate calls and update the triangle representations so we're ready for collision detection after each move
-void Tetrahedron::Rotate(Real roll, Real pitch, Real yaw)
-{
-    Shape::Rotate(roll, pitch, yaw);
-    this->UpdateTriangles();
+    return vertices;
 }
-void Tetrahedron::Translate(Vector dr)
+
+Real Tetrahedron::GetCircumradius()
 {
-    Shape::Translate(dr);
-    this->UpdateTriangles();
+    return sqrt(6.)/4.0;
 }
@@ -1,29 +1,15 @@
 #pragma once
 #include "Shape.h"
 
+// Corner + two edges of one face, in the form tr_tri_intersect3D expects (built on the fly by IntersectsTriangles)
 class Triangle
 {
     public:
     
-    Real *vertex, *edge1, *edge2;
+    Real vertex[3], edge1[3], edge2[3];
 
-    Triangle(Vector e0, Vector e1, Vector e2)
+    Triangle(const Vector &e0, const Vector &e1, const Vector &e2)
     {   
-        this->vertex = new Real[3];
-        this->edge1 = new Real[3];
-        this->edge2 = new Real[3];
-
-        this->Update(e0, e1, e2);
-    }
-    ~Triangle()
-    {
-        delete [] vertex;
-        delete [] edge1;
-        delete [] edge2;
-    }
-    
-    void Update(Vector &e0, Vector &e1, Vector &e2)
-    {
         // Set the vertex to the first corner
         for(int i=0;i<3;i++)
             vertex[i] = e0[i];
@@ -59,19 +45,69 @@ class Triangle
     }
 };
 
+class TetraBatch;
+
 class Tetrahedron: public Shape
 {
     public:
-    std::vector<Triangle*> triangles;
-    
-    Tetrahedron(Vector origin, float roll=0, float pitch=0, float yaw=0);
-    Tetrahedron(Tetrahedron &t);
-    ~Tetrahedron();
+    // Candidate container used by the batched narrow phase in MCDriver::CollisionDetectedWith
+    typedef TetraBatch Batch;
+
+    // Narrow-phase overlap kernels: SAT (separating axis test, default) or the original 4x4 triangle-triangle tests
+    enum OverlapKernel { SAT, TRIANGLES };
+    static OverlapKernel overlap_kernel;
 
-    bool Intersects(Shape *t2);
+    Tetrahedron(ParticleStore *store, uint index);
+
+    bool Intersects(Tetrahedron *t2, const Vector &offset);
+    bool IntersectsSAT(Tetrahedron *t2, const Vector &offset);
+    bool IntersectsTriangles(Tetrahedron *t2, const Vector &offset);
+    bool IntersectsAny(const TetraBatch &batch);
+    Real Clearance(Tetrahedron *t2, const Vector &offset);
+    // Distance we can move along the unit vector `d` before touching t2 translated by `offset`
+    Real ContactDistance(Tetrahedron *t2, const Vector &offset, const Vector &d);
     Real GetVolume();
 
-    void UpdateTriangles();
-    void Rotate(Real roll, Real pitch, Real yaw);
-    void Translate(Vector v);
+    // Vertices of a regular tetrahedron with unit edges, centered on its COM (the ParticleStore body frame)
+    static std::vector<Vector> GetBodyVertices();
+
+    // Radius of the sphere circumscribing a regular tetrahedron with unit edges (sets the range of the broad phase)
+    static Real GetCircumradius();
+};
+
+// ========================================================================================================
+// TetraBatch - Up to WIDTH candidate tetrahedra (or periodic images) to be tested against one particle in a 
+//              single call. Vertices are stored structure-of-arrays (x[v][c] is the x coordinate of vertex v of 
+//              candidate c) in single precision, relative to the tested particle's center of mass, so the SAT 
+//              kernel can evaluate one axis for all candidates at once in an AVX2 register.
+// ========================================================================================================
+class TetraBatch
+{
+    public:
+    static const int WIDTH = 8;
+
+    // Set at startup: use the AVX2 kernel if the host supports it (the scalar kernel gives identical results)
+    static bool use_avx2;
+
+    alignas(32) float x[4][WIDTH];
+    alignas(32) float y[4][WIDTH];
+    alignas(32) float z[4][WIDTH];
+    int size;
+
+    // The particle being tested and its center of mass
+    Tetrahedron t;
+    Vector origin;
+
+    // Kept for the (pairwise) triangle kernel
+    uint candidates[WIDTH];
+    Vector offsets[WIDTH];
+
+    TetraBatch(const Tetrahedron &t);
+
+    // Queue particle `j` of the tested particle's store translated by `offset` (candidates outside the bounding 
+    // sphere are dropped right away). Returns true once the batch is full and should be flushed.
+    bool Add(uint j, const Vector &offset);
+
+    // Test all queued candidates against `t` and empty the batch. Returns true if any of them overlaps.
+    bool Flush();
 };
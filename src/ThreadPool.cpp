@@ -0,0 +1,90 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int n_threads)
+{
+    this->n_tasks = 0;
+    this->next_task = 0;
+    this->n_finished = 0;
+    this->generation = 0;
+    this->stopping = false;
+
+    // The calling thread also works on each batch, so only spawn n_threads-1 helpers
+    for(int i=1;i<n_threads;i++)
+        this->workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> guard(this->lock);
+        this->stopping = true;
+    }
+    this->work_ready.notify_all();
+
+    for(unsigned int i=0;i<this->workers.size();i++)
+        this->workers[i].join();
+}
+
+int ThreadPool::GetThreadCount()
+{
+    return this->workers.size() + 1;
+}
+
+// Pull task indices until the batch is exhausted
+void ThreadPool::RunTasks()
+{
+    for(int i=this->next_task++; i<this->n_tasks; i=this->next_task++)
+        this->task(i);
+}
+
+void ThreadPool::WorkerLoop()
+{
+    unsigned long seen = 0;
+
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> guard(this->lock);
+            this->work_ready.wait(guard, [&]{ return this->stopping || this->generation != seen; });
+
+            if(this->stopping)
+                return;
+
+            seen = this->generation;
+        }
+
+        this->RunTasks();
+
+        {
+            std::unique_lock<std::mutex> guard(this->lock);
+            this->n_finished++;
+        }
+        this->work_done.notify_all();
+    }
+}
+
+void ThreadPool::Run(std::function<void(int)> task, int n_tasks)
+{
+    if(this->workers.empty())
+    {
+        for(int i=0;i<n_tasks;i++)
+            task(i);
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> guard(this->lock);
+        this->task = task;
+        this->n_tasks = n_tasks;
+        this->next_task = 0;
+        this->n_finished = 0;
+        this->generation++;
+    }
+    this->work_ready.notify_all();
+
+    // Help out, then wait at the barrier until every worker has checked in for this batch
+    this->RunTasks();
+
+    std::unique_lock<std::mutex> guard(this->lock);
+    this->work_done.wait(guard, [&]{ return this->n_finished == this->workers.size(); });
+}
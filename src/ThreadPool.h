@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that execute a batch of independent tasks and then meet at a barrier.
+// Used to advance the parallel tempering replicas concurrently - each task touches only its own MCDriver.
+class ThreadPool
+{
+    private:
+    std::vector<std::thread> workers;
+
+    std::mutex lock;
+    std::condition_variable work_ready, work_done;
+
+    // Current batch: task(i) for i in [0, n_tasks)
+    std::function<void(int)> task;
+    int n_tasks;
+    std::atomic<int> next_task;
+    // Number of workers that have finished their share of the current batch
+    unsigned int n_finished;
+
+    // Incremented for every batch so the workers can tell a new batch from a spurious wakeup
+    unsigned long generation;
+    bool stopping;
+
+    void WorkerLoop();
+    void RunTasks();
+
+    public:
+    // n_threads <= 1 runs every batch inline on the calling thread
+    ThreadPool(int n_threads);
+    ~ThreadPool();
+
+    // Run task(i) for every i in [0, n_tasks) and block until all of them have finished
+    void Run(std::function<void(int)> task, int n_tasks);
+    int GetThreadCount();
+};
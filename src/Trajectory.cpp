@@ -0,0 +1,135 @@
+#include <cstring>
+#include <unistd.h>
+#include "Trajectory.h"
+#include "Checkpoint.h"
+
+static const char MAGIC[8] = {'T', 'E', 'T', 'R', 'T', 'R', 'A', 'J'};
+
+// Size of a file in bytes (0 if it can't be opened)
+static uint64_t FileSize(const std::string &fname)
+{
+    std::ifstream f(fname, std::ios::binary | std::ios::ate);
+    return f ? (uint64_t)f.tellg() : 0;
+}
+
+TrajectoryWriter::TrajectoryWriter(std::string fname, ParticleStore *particles)
+{
+    this->fname = fname;
+    this->n_particles = particles->Size();
+    this->n_vertices = particles->n_vertices;
+    this->n_frames = 0;
+
+    for(uint k=0;k<this->n_vertices;k++)
+        for(int d=0;d<3;d++)
+            this->body.push_back(particles->body[k][d]);
+
+    // Pad the header so the frames (and their float64 cell tensors) start 8 byte aligned
+    this->header_size = sizeof(MAGIC) + 5*sizeof(uint32_t) + this->body.size()*sizeof(float);
+    this->header_size = (this->header_size + 7) / 8 * 8;
+    this->frame_size = sizeof(int64_t) + sizeof(uint32_t) + sizeof(float) + 9*sizeof(double) + 7*this->n_particles*sizeof(float);
+
+    this->frame.resize(this->frame_size);
+}
+
+bool TrajectoryWriter::Open(uint64_t n_frames)
+{
+    std::string fname_index = this->fname + ".idx";
+
+    if (n_frames == 0)
+    {
+        this->data.open(this->fname, std::ios::binary | std::ios::trunc);
+        this->index.open(fname_index, std::ios::binary | std::ios::trunc);
+        this->WriteHeader();
+    }
+    else
+    {
+        // Drop whatever was written after the frames we are continuing from
+        uint64_t size = this->header_size + n_frames*this->frame_size;
+        if (!this->CheckHeader() || FileSize(this->fname) < size || FileSize(fname_index) < n_frames*sizeof(uint64_t))
+            return false;
+
+        if (truncate(this->fname.c_str(), size) != 0 ||
+            truncate(fname_index.c_str(), n_frames*sizeof(uint64_t)) != 0)
+            return false;
+
+        this->data.open(this->fname, std::ios::binary | std::ios::app);
+        this->index.open(fname_index, std::ios::binary | std::ios::app);
+    }
+
+    this->n_frames = n_frames;
+    return this->data.good() && this->index.good();
+}
+
+void TrajectoryWriter::WriteHeader()
+{
+    std::vector<char> header(this->header_size, 0);
+    char *p = header.data();
+
+    uint32_t fields[5] = {VERSION, this->n_particles, this->n_vertices, this->header_size, this->frame_size};
+    memcpy(p, MAGIC, sizeof(MAGIC));                         p += sizeof(MAGIC);
+    memcpy(p, fields, sizeof(fields));                       p += sizeof(fields);
+    memcpy(p, this->body.data(), this->body.size()*sizeof(float));
+
+    this->data.write(header.data(), header.size());
+    this->data.flush();
+}
+
+bool TrajectoryWriter::CheckHeader()
+{
+    std::ifstream f(this->fname, std::ios::binary);
+
+    char magic[sizeof(MAGIC)];
+    uint32_t fields[5];
+    f.read(magic, sizeof(magic));
+    f.read(reinterpret_cast<char*>(fields), sizeof(fields));
+
+    uint32_t expected[5] = {VERSION, this->n_particles, this->n_vertices, this->header_size, this->frame_size};
+    return f && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0 && memcmp(fields, expected, sizeof(fields)) == 0;
+}
+
+// ========================================================================================================
+// Append - Pack the frame (float32 COMs/orientations straight from the particle arrays) and write it, then
+//          record its offset in the index
+// ========================================================================================================
+void TrajectoryWriter::Append(int64_t step, uint32_t driver, Real BetaP, Cell &cell, ParticleStore &particles)
+{
+    char *p = this->frame.data();
+
+    float betap = BetaP;
+    memcpy(p, &step, sizeof(step));                          p += sizeof(step);
+    memcpy(p, &driver, sizeof(driver));                      p += sizeof(driver);
+    memcpy(p, &betap, sizeof(betap));                        p += sizeof(betap);
+
+    double h[9];
+    for(int i=0;i<3;i++)
+        for(int j=0;j<3;j++)
+            h[3*i + j] = cell.h(i, j);
+    memcpy(p, h, sizeof(h));                                 p += sizeof(h);
+
+    for(uint i=0;i<this->n_particles;i++)
+    {
+        Vector r = particles.GetCOM(i);
+        float com[3] = {(float)r[0], (float)r[1], (float)r[2]};
+        memcpy(p, com, sizeof(com));                         p += sizeof(com);
+    }
+
+    for(uint i=0;i<this->n_particles;i++)
+    {
+        float q[4] = {(float)particles.qw[i], (float)particles.qx[i], (float)particles.qy[i], (float)particles.qz[i]};
+        memcpy(p, q, sizeof(q));                             p += sizeof(q);
+    }
+
+    uint64_t offset = this->header_size + this->n_frames*this->frame_size;
+    this->data.write(this->frame.data(), this->frame.size());
+    this->data.flush();
+
+    checkpoint::Write(this->index, offset);
+    this->index.flush();
+
+    this->n_frames++;
+}
+
+uint64_t TrajectoryWriter::Size()
+{
+    return this->n_frames;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include "Globals.h"
+#include "Cell.h"
+#include "ParticleStore.h"
+
+// ========================================================================================================
+// TrajectoryWriter - Append-only binary trajectory of (replica) snapshots, read back with numpy.memmap by
+// citrine_challenge.load_trajectory. All values are little-endian.
+//
+//   header:  char magic[8] = "TETRTRAJ", uint32 version, n_particles, n_vertices, header_size, frame_size,
+//            float32 body[n_vertices][3] (vertices relative to the COM), zero padding up to header_size
+//   frame:   int64 step, uint32 driver, float32 BetaP, float64 h[3][3] (row-major, the cell vectors are the
+//            columns), float32 com[n_particles][3], float32 q[n_particles][4] (w, x, y, z)
+//
+// Frames are fixed size and follow the header back to back. The offset of every frame is also appended to
+// `<fname>.idx` (uint64) once the frame is completely written, so a reader never sees a torn frame.
+// ========================================================================================================
+class TrajectoryWriter
+{
+    public:
+    static const uint32_t VERSION = 1;
+
+    TrajectoryWriter(std::string fname, ParticleStore *particles);
+
+    // Start writing after the first `n_frames` frames of an existing file (restart), or start a new file when
+    // n_frames = 0. Returns false if the existing file is for a different system or has fewer frames.
+    bool Open(uint64_t n_frames);
+
+    // Append one snapshot of `particles` in `cell`
+    void Append(int64_t step, uint32_t driver, Real BetaP, Cell &cell, ParticleStore &particles);
+
+    // Number of frames in the file
+    uint64_t Size();
+
+    private:
+    std::string fname;
+    std::ofstream data, index;
+
+    std::vector<float> body;
+    uint32_t n_particles, n_vertices, header_size, frame_size;
+    uint64_t n_frames;
+
+    // Frame staging buffer, so a frame goes out in a single write
+    std::vector<char> frame;
+
+    void WriteHeader();
+    bool CheckHeader();
+};
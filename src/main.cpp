@@ -2,20 +2,31 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <cstdio>
+#include <cstring>
 #include <time.h>
 
 // Custom includes
 #include "Globals.h"
 #include "Tetrahedron.h"
 #include "Sphere.h"
+#include "ConvexPolyhedron.h"
 #include "Cell.h"
 #include "Moves.h"
 #include "MCDriver.h"
+#include "ThreadPool.h"
+#include "Checkpoint.h"
+#include "Trajectory.h"
+#include "OutputWriter.h"
+#include "ReplicaExchange.h"
+#include "ReplicaLink.h"
 
 using namespace std;
 
-// Choose shape to use - valid choices: {Tetrahedron, Sphere}
-typedef Tetrahedron ChosenShape;
+// Particle shape, chosen at startup with the `shape` option - valid choices: {tetrahedron, sphere} or a convex
+// polyhedron {octahedron, cube, truncated_tetrahedron, polyhedron (vertices from `vertex_file`)}
+string shape;
+vector<Vector> GetPolyhedronVertices(string shape);
 
 // Output
 int output_count = 0;
@@ -23,17 +34,48 @@ Real BestSolution = 0;
 Real BestSolutionPrinted = 0;
 
 template <class T>
-void PrintOutput(string str, MCDriver<T> &d);
+void PrintOutput(OutputWriter &writer, string str, MCDriver<T> &d);
 template <class T>
 MCDriver<T>* GetBestDriver(vector<MCDriver<T>*> drivers);
 
 // Command line arg parsing
 vector<string> keys;
 vector<Real> values;
+vector<string> raw_values;
 Real GetParameter(string p, Real def = -1234321);
+string GetStringParameter(string p, string def);
 
+// Each replica advances `n_batch` MC steps on its own worker between tempering swaps
+int n_batch;
+
+// Multi-process runs: this process is `process_rank` of `n_procs` and hosts drivers [first_driver, first_driver + its 
+// driver count) of the `total_drivers` in the run. The ranks share the tempering ladder through replica_link.
+int process_rank, n_procs, first_driver, total_drivers;
+ReplicaLink *replica_link = NULL;
+string RankSuffix(string fname);
+
+// Checkpoint/restart (one file per rank - n_drivers counts the drivers of every rank)
+struct CheckpointHeader
+{
+    char shape[16];
+    uint32_t n_drivers, n_particles, n_vertices, n_batch;
+    uint32_t n_procs, rank;
+};
+struct RunState
+{
+    int step, next_write, next_frame;
+    uint64_t n_frames;
+};
+template <class T>
+void WriteCheckpoint(string fname, const RunState &run, ReplicaExchange &tempering, vector<MCDriver<T>*> &drivers);
+bool ReadCheckpointHeader(istream &in, CheckpointHeader &header);
 template <class T>
-void RunProduction(vector<MCDriver<T>*> drivers);
+bool ReadCheckpoint(istream &in, RunState &run, ReplicaExchange &tempering, vector<MCDriver<T>*> &drivers);
+
+template <class T>
+void Simulate(int n_drivers, int n_particles, uint64_t seed, istream *checkpoint, uint32_t n_vertices);
+template <class T>
+void RunProduction(vector<MCDriver<T>*> drivers, RunState run, ReplicaExchange &tempering);
 
 // Main Declaration
 int main(int argc, char* argv[])
@@ -43,10 +85,12 @@ int main(int argc, char* argv[])
     {
         keys.push_back(string(argv[i]));
         values.push_back(atof(argv[i+1]));
+        raw_values.push_back(string(argv[i+1]));
     }
 
-    // Initialize the RNG
-    srand(time(NULL));
+    // Initialize the RNG - the main stream drives the tempering swaps, each driver gets its own stream
+    uint64_t seed = stoull(GetStringParameter("seed", to_string(time(NULL))));
+    global_rng.Seed(seed);
 
     // Create the subsystems for the parallel tempering scheme
     // Each subsystem will be at a different pressure, with 
@@ -54,80 +98,287 @@ int main(int argc, char* argv[])
     // This typically works better than simulated annealing (ie. slow pressure ramp)
     int n_drivers = GetParameter("n_drivers", 1);
 
+    // Multi-process mode: start the same command once per rank (rank 0..n_procs-1), rank 0 coordinates the swaps
+    n_procs = std::max(1, (int)GetParameter("n_procs", 1));
+    process_rank = GetParameter("rank", 0);
+    if (process_rank < 0 || process_rank >= n_procs)
+    {
+        cout << "Error: rank must be between 0 and n_procs-1" << endl;
+        exit(1);
+    }
+
+    // Narrow-phase kernel for tetrahedra: "sat" (default) or "triangles"
+    string overlap = GetStringParameter("overlap", "sat");
+    if (overlap == "sat")
+        Tetrahedron::overlap_kernel = Tetrahedron::SAT;
+    else if (overlap == "triangles")
+        Tetrahedron::overlap_kernel = Tetrahedron::TRIANGLES;
+    else
+    {
+        cout << "Error: Unknown overlap kernel " << overlap << " (valid choices: sat, triangles)" << endl;
+        exit(1);
+    }
+
     // Driver Options
     int n_particles = GetParameter("n_particles", 2);
+    shape = GetStringParameter("shape", "tetrahedron");
+
+    // When restarting, the checkpoint decides the shape and system size (and the batching, which sets when swaps happen)
+    string restart = GetStringParameter("restart", "");
+    ifstream checkpoint;
+    CheckpointHeader header = CheckpointHeader();
+    if (restart != "")
+    {
+        restart = RankSuffix(restart);
+        checkpoint.open(restart, ios::binary);
+        if (!ReadCheckpointHeader(checkpoint, header))
+        {
+            cout << "Error: " << restart << " is not a checkpoint of this build" << endl;
+            exit(1);
+        }
+        if ((int)header.n_procs != n_procs || (int)header.rank != process_rank)
+        {
+            cout << "Error: " << restart << " is rank " << header.rank << " of " << header.n_procs << " processes" << endl;
+            exit(1);
+        }
+
+        shape = string(header.shape);
+        n_drivers = header.n_drivers;
+        n_particles = header.n_particles;
+        n_batch = header.n_batch;
+    }
+    else
+        n_batch = std::max(1, (int)GetParameter("n_batch", 10));
+
+    if (n_drivers < n_procs)
+    {
+        cout << "Error: Every process needs at least one driver (n_drivers < n_procs)" << endl;
+        exit(1);
+    }
+
+    if (n_procs > 1)
+    {
+        string address = GetStringParameter("coordinator", "unix:output/coordinator.sock");
+        // Every rank has to run the same ladder (rank 0 checks)
+        vector<Real> ladder;
+        for(int i=0;i<n_drivers;i++)
+            ladder.push_back(GetParameter(string("p")+to_string(i), 100));
+
+        replica_link = new ReplicaLink(process_rank, n_procs);
+        if (!replica_link->Connect(address, GetParameter("connect_timeout", 60), ladder))
+        {
+            cout << "Error: Couldn't connect the " << n_procs << " processes through " << address << ": "
+                 << replica_link->error << endl;
+            exit(1);
+        }
+    }
+
+    // Pick the MCDriver instantiation once - everything below runs fully specialized for that shape
+    istream *in = (restart != "") ? &checkpoint : NULL;
+    if (shape == "tetrahedron")
+        Simulate<Tetrahedron>(n_drivers, n_particles, seed, in, header.n_vertices);
+    else if (shape == "sphere")
+        Simulate<Sphere>(n_drivers, n_particles, seed, in, header.n_vertices);
+    else if (shape == "octahedron" || shape == "cube" || shape == "truncated_tetrahedron" || shape == "polyhedron")
+    {
+        if (!ConvexPolyhedron::SetBody(GetPolyhedronVertices(shape)))
+        {
+            cout << "Error: The vertices of " << shape << " don't describe a solid" << endl;
+            exit(1);
+        }
+        Simulate<ConvexPolyhedron>(n_drivers, n_particles, seed, in, header.n_vertices);
+    }
+    else
+    {
+        cout << "Error: Unknown shape " << shape << " (valid choices: tetrahedron, sphere, octahedron, cube, truncated_tetrahedron, polyhedron)" << endl;
+        exit(1);
+    }
+
+    delete replica_link;
+    return 0;
+}
+
+// ============================================================================
+// Build the drivers for shape T (or restore them from `checkpoint`, whose particles have `n_vertices` vertices) 
+// and run
+// ============================================================================
+template <class T>
+void Simulate(int n_drivers, int n_particles, uint64_t seed, istream *checkpoint, uint32_t n_vertices)
+{
     Real p_cell_move = GetParameter("p_cell_move", 1.0/(n_particles+1));
         
-    // Construct the subsystems and add them to a driver list
-    vector< MCDriver<ChosenShape>* > drivers;
-    for(int i=0;i<n_drivers;i++)
+    // Construct the subsystems of this process and add them to a driver list. Driver i gets the same RNG stream and
+    // pressure whichever process hosts it.
+    int last_driver;
+    total_drivers = n_drivers;
+    ReplicaLink::GetRange(n_drivers, process_rank, n_procs, first_driver, last_driver);
+
+    vector< MCDriver<T>* > drivers;
+    for(int i=first_driver;i<last_driver;i++)
     {
-        MCDriver<ChosenShape> *d = new MCDriver<ChosenShape>(n_particles, p_cell_move);
+        MCDriver<T> *d = new MCDriver<T>(n_particles, RNG(seed, i+1), p_cell_move);
 
         // Set options
         d->BetaP = GetParameter(string("p")+to_string(i), 100);
         d->SetCellShapeDelta(GetParameter("dcell", 0.02));
         d->SetParticleTranslationDelta(GetParameter("dr", 0.02));
-        d->Project_Threshold = GetParameter("ProjectionThreshold", 0.65);
+        d->p_event_chain = GetParameter("p_event_chain", 0);
+        d->SetEventChainLength(GetParameter("chain_length", 1));
         
         drivers.push_back(d);
     }
 
-    RunProduction(drivers);
-    return 0;
+    // Pressure ladder for the parallel tempering swaps (a sweep every `swap_interval` steps, at the first barrier
+    // after it's due)
+    vector<Real> pressures;
+    for(int i=0;i<n_drivers;i++)
+        pressures.push_back(GetParameter(string("p")+to_string(i), 100));
+    ReplicaExchange tempering(pressures, GetParameter("swap_interval", n_batch), GetParameter("adapt_interval", 0));
+
+    // Pick up the state of every driver (and of the run itself) where the checkpoint left it
+    RunState run = {0, 0, 0, 0};
+    if (checkpoint)
+    {
+        if (drivers[0]->particles.n_vertices != (int)n_vertices || !ReadCheckpoint(*checkpoint, run, tempering, drivers))
+        {
+            cout << "Error: Couldn't read checkpoint " << RankSuffix(GetStringParameter("restart", "")) << endl;
+            exit(1);
+        }
+        cout << "Restarting from step " << run.step << endl;
+    }
+
+    RunProduction(drivers, run, tempering);
 }
 
 // ============================================================================
 // Run the actual MC simulation
 // ============================================================================
 template<class T>
-void RunProduction(vector< MCDriver<T>* > drivers)
+void RunProduction(vector< MCDriver<T>* > drivers, RunState run, ReplicaExchange &tempering)
 {
     MCDriver<T>* best;
 
     // Now run the MC Simulation
     int total = GetParameter("n_steps", 10000000);
+    int write_interval = std::max(1, total/(int)GetParameter("n_write", 25));
+
+    // A checkpoint is written (atomically) every `checkpoint_interval` steps and at the end of the run
+    int checkpoint_interval = GetParameter("checkpoint_interval", write_interval);
+    string checkpoint_file = RankSuffix(GetStringParameter("checkpoint_file", "output/checkpoint"));
+
+    // Every `traj_interval` steps a frame of each driver is appended to the binary trajectory (0 = off)
+    int traj_interval = GetParameter("traj_interval", 0);
+    TrajectoryWriter *trajectory = NULL;
+    if (traj_interval > 0)
+    {
+        string traj_file = RankSuffix(GetStringParameter("traj_file", "output/trajectory"));
+        trajectory = new TrajectoryWriter(traj_file, &drivers[0]->particles);
+        if (!trajectory->Open(run.n_frames))
+        {
+            cout << "Error: Couldn't continue the trajectory " << traj_file << " from frame " << run.n_frames << endl;
+            exit(1);
+        }
+    }
+
+    int n_threads = GetParameter("n_threads", std::thread::hardware_concurrency());
+    ThreadPool pool(std::max(1, std::min(n_threads, (int)drivers.size())));
+
+    // With `domain_threads` > 1 every driver also gets a pool of its own for checkerboard sweeps of its particle moves
+    int domain_threads = GetParameter("domain_threads", 1);
+    vector<ThreadPool*> domain_pools;
+    if (domain_threads > 1)
+    {
+        for(uint j=0;j<drivers.size();j++)
+        {
+            domain_pools.push_back(new ThreadPool(domain_threads));
+            drivers[j]->pool = domain_pools.back();
+        }
+    }
+
+    // Snapshots are formatted and written on a background thread (at most `output_queue` of them pending)
+    OutputWriter writer(GetParameter("output_queue", 64));
 
-    for(int i=0;i<total;i++)
+    // MC_STATS builds append every driver's counters/timers since the previous report to `stats_file` (JSON lines)
+    ofstream stats;
+    if (MCStats::ENABLED)
+        stats.open(RankSuffix(GetStringParameter("stats_file", "output/stats.json")), run.step > 0 ? ios::app : ios::trunc);
+
+    int next_checkpoint = checkpoint_interval > 0 ? (run.step/checkpoint_interval + 1)*checkpoint_interval : total;
+    int &next_write = run.next_write;
+    for(int &i=run.step;i<total;i+=n_batch)
     {
-        // Do a parallel tempering swap 
-        if(u(0,1) < 0.1 && drivers.size() > 1)
+        int steps = std::min(n_batch, total - i);
+
+        // Snapshot every replica at the barrier, before anything of step i has happened
+        if (trajectory && i >= run.next_frame)
+        {
+            run.next_frame = (i/traj_interval + 1)*traj_interval;
+            for(uint j=0;j<drivers.size();j++)
+                trajectory->Append(i, first_driver + j, drivers[j]->BetaP, drivers[j]->cell, drivers[j]->particles);
+            run.n_frames = trajectory->Size();
+        }
+
+        // Checkpoint (after the frames, so a restart doesn't repeat them) once every snapshot before it is on disk
+        if (i >= next_checkpoint)
+        {
+            next_checkpoint = (i/checkpoint_interval + 1)*checkpoint_interval;
+            writer.Flush();
+            WriteCheckpoint(checkpoint_file, run, tempering, drivers);
+        }
+
+        // Neighbor swap sweep over the pressure ladder at the barrier between batches. The replicas keep their 
+        // configurations and trade pressures, so the cell move statistics start over for whoever got a new one.
+        // In a multi-process run rank 0 sweeps over the pressures and volumes of every rank.
+        if(total_drivers > 1 && tempering.Due(i))
         {
-            int sys0, sys1;
-            sys0 = u(0,1)*drivers.size();
-            sys1 = u(0,1)*drivers.size();
-            while(sys1 == sys0)
-                sys1 = u(0,1)*drivers.size();
-            Real p0 = drivers[sys0]->BetaP;
-            Real p1 = drivers[sys1]->BetaP;
-            Real V0 = drivers[sys0]->cell.GetVolume();
-            Real V1 = drivers[sys1]->cell.GetVolume();
-
-            Real BoltzmannFactor = exp(-((p0-p1)*V1 + (p1-p0)*V0));
-            if( u(0, 1) < BoltzmannFactor )
+            vector<Real> pressures(drivers.size()), volumes(drivers.size());
+            for(uint j=0;j<drivers.size();j++)
+            {
+                pressures[j] = drivers[j]->BetaP;
+                volumes[j] = drivers[j]->cell.GetVolume();
+            }
+
+            auto sweep = [&](vector<Real> &p, const vector<Real> &V)
             {
-                drivers[sys0]->BetaP = p1;
-                drivers[sys1]->BetaP = p0;
+                tempering.Sweep(V, i, global_rng);
+                for(uint r=0;r<p.size();r++)
+                    p[r] = tempering.GetPressure(r);
+            };
+
+            if (!replica_link)
+                sweep(pressures, volumes);
+            else if (!replica_link->Exchange(i, pressures, volumes, sweep))
+            {
+                cout << "Error: Lost the connection to the other processes at step " << i << endl;
+                exit(1);
+            }
 
-                drivers[sys0]->cell_moves[0]->Reset();
-                drivers[sys1]->cell_moves[0]->Reset();
+            for(uint j=0;j<drivers.size();j++)
+            {
+                if (pressures[j] != drivers[j]->BetaP)
+                {
+                    drivers[j]->BetaP = pressures[j];
+                    drivers[j]->cell_moves[0]->Reset();
+                }
             }
         }
 
         // Print out every few steps
-        if(i%(total/(int)GetParameter("n_write", 25))==0)
+        if(i >= next_write)
         {
+            next_write = (i/write_interval + 1)*write_interval;
+
             cout << "===== Step " << i << " Completed =====" << endl;
             cout << endl;
             cout << "Best Solution: " << BestSolution << endl;
             cout << endl;
     
             for(uint j=0;j<drivers.size();j++)
-                PrintOutput(string("Driver_")+to_string(j)+string("_"), *drivers[j]);
+                PrintOutput(writer, string("Driver_")+to_string(first_driver + j)+string("_"), *drivers[j]);
             
             for(uint j=0;j<drivers.size();j++)
             {
-                cout << "System " << j << " (P=" << drivers[j]->BetaP << ")" << endl;
+                cout << "System " << first_driver + j << " (P=" << drivers[j]->BetaP << ")" << endl;
                 cout << "==========" << endl;
                 cout << "Volume: " << drivers[j]->cell.GetVolume() << endl;
                 cout << "Pack Fraction: " << drivers[j]->GetPackingFraction() << endl;
@@ -139,13 +390,27 @@ void RunProduction(vector< MCDriver<T>* > drivers)
                 cout << endl;
                 cout << endl;
             }
+
+            if (stats.is_open())
+            {
+                for(uint j=0;j<drivers.size();j++)
+                {
+                    stats << "{\"step\": " << i << ", \"driver\": " << first_driver + j << ", \"BetaP\": " << drivers[j]->BetaP
+                          << ", \"stats\": " << drivers[j]->stats.ToJSON() << "}" << endl;
+                    drivers[j]->stats.Reset();
+                }
+            }
+
+            // Only rank 0 keeps the swap statistics
+            if(total_drivers > 1 && process_rank == 0)
+                cout << tempering.ToString() << endl;
         }
 
-        // Take an MC Move in each subsystem
-        for(uint j=0;j<drivers.size();j++)
+        // Advance every subsystem by a batch of MC moves - the replicas are independent until the next barrier
+        pool.Run([&](int j)
         {
-            drivers[j]->MakeMove();
-        }
+            drivers[j]->MakeMoves(steps);
+        }, drivers.size());
 
         // Keep track of the best solution over time
         best = GetBestDriver(drivers);
@@ -154,7 +419,7 @@ void RunProduction(vector< MCDriver<T>* > drivers)
         // Only print it to a file if we've improved by at least 1%
         if(best_fraction - BestSolutionPrinted > 0.01)
         {
-            PrintOutput("best", *best);
+            PrintOutput(writer, n_procs > 1 ? "best_rank" + to_string(process_rank) + "_" : "best", *best);
             BestSolutionPrinted = best_fraction;
         }   
 
@@ -162,6 +427,15 @@ void RunProduction(vector< MCDriver<T>* > drivers)
             BestSolution = best_fraction;
     }
 
+    // The final state can be picked up again to extend the run (with a larger n_steps)
+    writer.Flush();
+    if (checkpoint_interval > 0)
+        WriteCheckpoint(checkpoint_file, run, tempering, drivers);
+
+    delete trajectory;
+    for(uint j=0;j<domain_pools.size();j++)
+        delete domain_pools[j];
+
     cout << "FINISHED - Best Solution: " << BestSolution << endl;
 }
 
@@ -169,17 +443,126 @@ void RunProduction(vector< MCDriver<T>* > drivers)
 // A few helper functions
 // ============================================================================
 template <class T>
-void PrintOutput(string str, MCDriver<T> &driver)
+void PrintOutput(OutputWriter &writer, string str, MCDriver<T> &driver)
 {
     char buff[100];
     sprintf(buff, "%04d", output_count);
     output_count++;
     string fname = "output/" + str + string(buff);
 
-    ofstream f;
-    f.open(fname);
-    f << driver.ToString();
+    // Hand a copy to the writer thread - the driver is free to move on immediately
+    writer.Write(fname, driver.cell, driver.particles);
+}
+
+// ============================================================================
+// Checkpoints: header, run state (step counters, best solution, output numbering, the tempering RNG and ladder), then
+// every driver (see MCDriver::Save). The file is written next to its destination and renamed over it, so a 
+// run killed mid-write leaves the previous checkpoint intact.
+// ============================================================================
+template <class T>
+void WriteCheckpoint(string fname, const RunState &run, ReplicaExchange &tempering, vector<MCDriver<T>*> &drivers)
+{
+    string tmp = fname + ".tmp";
+    ofstream f(tmp, ios::binary | ios::trunc);
+
+    CheckpointHeader header;
+    memset(header.shape, 0, sizeof(header.shape));
+    strncpy(header.shape, shape.c_str(), sizeof(header.shape) - 1);
+    header.n_drivers = total_drivers;
+    header.n_particles = drivers[0]->particles.Size();
+    header.n_vertices = drivers[0]->particles.n_vertices;
+    header.n_batch = n_batch;
+    header.n_procs = n_procs;
+    header.rank = process_rank;
+
+    f.write(checkpoint::MAGIC, sizeof(checkpoint::MAGIC));
+    checkpoint::Write(f, checkpoint::VERSION);
+    checkpoint::Write(f, header);
+
+    // Field by field - the struct has padding, which would go into the file uninitialized
+    checkpoint::Write(f, run.step);
+    checkpoint::Write(f, run.next_write);
+    checkpoint::Write(f, run.next_frame);
+    checkpoint::Write(f, run.n_frames);
+    checkpoint::Write(f, output_count);
+    checkpoint::Write(f, BestSolution);
+    checkpoint::Write(f, BestSolutionPrinted);
+    global_rng.Save(f);
+    tempering.Save(f);
+
+    for(uint j=0;j<drivers.size();j++)
+        drivers[j]->Save(f);
+
     f.close();
+    if (!f || rename(tmp.c_str(), fname.c_str()) != 0)
+    {
+        cout << "Error: Couldn't write checkpoint " << fname << endl;
+        exit(1);
+    }
+}
+
+bool ReadCheckpointHeader(istream &in, CheckpointHeader &header)
+{
+    char magic[sizeof(checkpoint::MAGIC)];
+    uint32_t version = 0;
+
+    in.read(magic, sizeof(magic));
+    checkpoint::Read(in, version);
+    checkpoint::Read(in, header);
+
+    header.shape[sizeof(header.shape) - 1] = 0;
+
+    return in && memcmp(magic, checkpoint::MAGIC, sizeof(magic)) == 0 && version == checkpoint::VERSION && header.n_drivers > 0;
+}
+
+template <class T>
+bool ReadCheckpoint(istream &in, RunState &run, ReplicaExchange &tempering, vector<MCDriver<T>*> &drivers)
+{
+    checkpoint::Read(in, run.step);
+    checkpoint::Read(in, run.next_write);
+    checkpoint::Read(in, run.next_frame);
+    checkpoint::Read(in, run.n_frames);
+    checkpoint::Read(in, output_count);
+    checkpoint::Read(in, BestSolution);
+    checkpoint::Read(in, BestSolutionPrinted);
+    global_rng.Load(in);
+    tempering.Load(in);
+
+    for(uint j=0;j<drivers.size();j++)
+        drivers[j]->Load(in);
+
+    // Anything left over means the file doesn't match what we just read it as
+    return in && in.peek() == EOF;
+}
+
+// Every rank of a multi-process run writes its own checkpoint/trajectory: <fname>.<rank>
+string RankSuffix(string fname)
+{
+    if (n_procs > 1 && fname != "")
+        return fname + "." + to_string(process_rank);
+
+    return fname;
+}
+
+// Body vertices for the ConvexPolyhedron shapes
+vector<Vector> GetPolyhedronVertices(string shape)
+{
+    if (shape == "octahedron")
+        return ConvexPolyhedron::Octahedron();
+    if (shape == "cube")
+        return ConvexPolyhedron::Cube();
+    if (shape == "truncated_tetrahedron")
+        return ConvexPolyhedron::TruncatedTetrahedron();
+
+    string fname = GetStringParameter("vertex_file", "");
+    vector<Vector> vertices = ConvexPolyhedron::LoadVertices(fname);
+    if (vertices.empty())
+    {
+        cout << "Error: Couldn't read any vertices from vertex_file '" << fname << "'" << endl;
+        exit(1);
+    }
+
+    return vertices;
 }
 
 Real GetParameter(string param_name, Real default_value)
@@ -198,6 +581,18 @@ Real GetParameter(string param_name, Real default_value)
     exit(1);
 }
 
+// Same as GetParameter, but returns the argument verbatim (for values that don't survive a trip through Real)
+string GetStringParameter(string param_name, string default_value)
+{
+    for(uint i=0;i<keys.size();i++)
+    {
+        if (keys[i] == param_name)
+            return raw_values[i];
+    }
+
+    return default_value;
+}
+
 template <class T>
 MCDriver<T>* GetBestDriver(vector<MCDriver<T>*> drivers)
 {
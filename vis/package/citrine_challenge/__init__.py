@@ -1,7 +1,14 @@
-from scipy.spatial import ConvexHull
-from mayavi import mlab
 import numpy as np
 
+# Painting needs scipy and mayavi, loading (e.g. trajectories for analysis) doesn't
+try:
+    from scipy.spatial import ConvexHull
+    from mayavi import mlab
+except ImportError:
+    ConvexHull = mlab = None
+
+from .trajectory import Trajectory, load_trajectory
+
 
 class Cell(object):
     """
@@ -65,7 +72,7 @@ class Tetrahedron(object):
         :param pts: pts array (x1, y1, z1, x2, y2, z2, ... z4)
         """
         self.points = []
-        for i in range(len(pts) / 3):
+        for i in range(len(pts) // 3):
             self.points.append([pts[3 * i + j] for j in range(3)])
 
         self.points = np.array(self.points, float)
@@ -143,3 +150,19 @@ def display_solution(fname):
 
     for particle in particles:
         particle.paint()
+
+
+def solution_from_trajectory(traj, k):
+    """
+    Unit cell and particles of frame `k` of a trajectory, as load_solution would return them.
+
+    :param traj: a Trajectory (see load_trajectory)
+    :param k: frame index
+    :return: the unit cell and particles list
+    """
+    h = np.asarray(traj.frames['h'][k])
+    cell = Cell(h[:, 0], h[:, 1], h[:, 2])
+
+    particles = [Tetrahedron(*v.ravel()) for v in traj.vertices(k)]
+
+    return cell, particles
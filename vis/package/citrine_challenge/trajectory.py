@@ -0,0 +1,101 @@
+import os
+import numpy as np
+
+MAGIC = b"TETRTRAJ"
+VERSION = 1
+
+# magic, version, n_particles, n_vertices, header_size, frame_size (see src/Trajectory.h)
+_header_dtype = np.dtype([('magic', 'S8'), ('version', '<u4'), ('n_particles', '<u4'), ('n_vertices', '<u4'),
+                          ('header_size', '<u4'), ('frame_size', '<u4')])
+
+
+def frame_dtype(n_particles):
+    """
+    The numpy dtype of one trajectory frame.
+
+    :param n_particles: number of particles per frame
+    :return: structured dtype with fields step, driver, BetaP, h (3x3, cell vectors are the columns), com (n x 3)
+             and q (n x 4 unit quaternions, w x y z)
+    """
+    return np.dtype([('step', '<i8'), ('driver', '<u4'), ('BetaP', '<f4'), ('h', '<f8', (3, 3)),
+                     ('com', '<f4', (n_particles, 3)), ('q', '<f4', (n_particles, 4))])
+
+
+class Trajectory(object):
+    """
+    A binary trajectory written by `./main traj_interval N`, memory-mapped so only the frames (and fields) that
+    are touched get read from disk.
+
+    `frames` is a numpy record array, e.g. `traj.frames['h'][traj.frames['driver'] == 0]` is the cell tensor of
+    replica 0 over time.
+    """
+
+    def __init__(self, fname):
+        header = np.fromfile(fname, dtype=_header_dtype, count=1)
+        if len(header) == 0 or header['magic'][0] != MAGIC:
+            raise IOError("{} is not a tetr trajectory".format(fname))
+        if header['version'][0] != VERSION:
+            raise IOError("{} has trajectory version {}, expected {}".format(fname, header['version'][0], VERSION))
+
+        self.n_particles = int(header['n_particles'][0])
+        self.n_vertices = int(header['n_vertices'][0])
+        header_size = int(header['header_size'][0])
+
+        dtype = frame_dtype(self.n_particles)
+        assert dtype.itemsize == header['frame_size'][0], "frame layout doesn't match the writer"
+
+        # Body-frame vertices (relative to the COM) shared by every particle
+        self.body = np.fromfile(fname, dtype='<f4', count=3 * self.n_vertices,
+                                offset=_header_dtype.itemsize).reshape(self.n_vertices, 3)
+
+        # Only frames listed in the index are complete (the writer appends to it after each frame)
+        index = fname + ".idx"
+        if os.path.exists(index):
+            n_frames = os.path.getsize(index) // 8
+        else:
+            n_frames = (os.path.getsize(fname) - header_size) // dtype.itemsize
+
+        if n_frames > 0:
+            self.frames = np.memmap(fname, dtype=dtype, mode='r', offset=header_size, shape=(n_frames,))
+        else:
+            self.frames = np.zeros(0, dtype=dtype)
+
+    def __len__(self):
+        return len(self.frames)
+
+    def __getitem__(self, k):
+        return self.frames[k]
+
+    def vertices(self, k):
+        """
+        World-space vertices of every particle in frame `k`.
+
+        :param k: frame index
+        :return: (n_particles, n_vertices, 3) array
+        """
+        q = np.asarray(self.frames['q'][k], float)
+        w, x, y, z = q[:, 0], q[:, 1], q[:, 2], q[:, 3]
+
+        # Rotation matrix of each unit quaternion
+        r = np.empty((len(q), 3, 3))
+        r[:, 0, 0] = 1 - 2 * (y * y + z * z)
+        r[:, 0, 1] = 2 * (x * y - w * z)
+        r[:, 0, 2] = 2 * (x * z + w * y)
+        r[:, 1, 0] = 2 * (x * y + w * z)
+        r[:, 1, 1] = 1 - 2 * (x * x + z * z)
+        r[:, 1, 2] = 2 * (y * z - w * x)
+        r[:, 2, 0] = 2 * (x * z - w * y)
+        r[:, 2, 1] = 2 * (y * z + w * x)
+        r[:, 2, 2] = 1 - 2 * (x * x + y * y)
+
+        return np.asarray(self.frames['com'][k], float)[:, None, :] + np.einsum('pij,vj->pvi', r, self.body)
+
+
+def load_trajectory(fname):
+    """
+    Memory-map a binary trajectory file.
+
+    :param fname: full path to the trajectory (its `.idx` index is picked up from next to it)
+    :return: a Trajectory
+    """
+    return Trajectory(fname)